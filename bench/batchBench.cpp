@@ -0,0 +1,65 @@
+// find() in a loop vs find_batch() on a table much larger than the cache.
+//
+// Lookups are half hits and half misses in random order, so almost every
+// one of them misses the cache.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+
+enum { KEYS = 1 << 22, LOOKUPS = 1 << 20, ROUNDS = 5 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Policy>
+static void run(const char* name, const std::vector<key_t_>& keys, const std::vector<key_t_>& lookups)
+{
+	typedef hashTable<key_t_, key_t_, std::hash<key_t_>, std::equal_to<key_t_>,
+		std::allocator<pair<const key_t_, key_t_> >, Policy> table_type;
+	table_type table;
+	table.reserve(keys.size());
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		table.try_emplace(keys[i], i);
+
+	// best of ROUNDS, the runs are short enough to be noisy
+	std::size_t found = 0;
+	double loop_ns = 1e300, batch_ns = 1e300;
+	for(int round = 0; round < ROUNDS; ++round)
+	{
+		double start = now_ns();
+		for(std::size_t i = 0; i < lookups.size(); ++i)
+			found += table.count(lookups[i]);
+		double ns = (now_ns() - start) / lookups.size();
+		loop_ns = ns < loop_ns ? ns : loop_ns;
+
+		start = now_ns();
+		found += table.count_batch(lookups.begin(), lookups.end());
+		ns = (now_ns() - start) / lookups.size();
+		batch_ns = ns < batch_ns ? ns : batch_ns;
+	}
+
+	std::printf("%-8s %10.2f %10.2f %12zu\n", name, loop_ns, batch_ns, found);
+}
+
+int main()
+{
+	std::mt19937_64 rng(12345);
+	std::vector<key_t_> keys(KEYS), lookups(LOOKUPS);
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		keys[i] = rng() | 1;
+	for(std::size_t i = 0; i < lookups.size(); ++i)
+		lookups[i] = i % 2 ? keys[rng() % keys.size()] : rng() & ~key_t_(1);
+
+	std::printf("%-8s %10s %10s %12s\n", "layout", "loop/ns", "batch/ns", "found");
+	run<chained_policy>("chained", keys, lookups);
+	run<open_addressing_policy>("flat", keys, lookups);
+	return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef __BENCH_HARNESS_H__
+#define __BENCH_HARNESS_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness in the spirit of google benchmark, with no
+// dependencies.
+//
+// A benchmark body gets a benchTimer, does its own setup, and brackets
+// only the measured part with start() and stop(). It returns the number
+// of operations that part performed. The body is repeated and the
+// fastest run is kept. Every result is printed as a table row and, if
+// --json=<file> was given, written to that file at exit.
+class benchTimer
+{
+public:
+	benchTimer() : __elapsed(0) {}
+
+	void start() { __start = std::chrono::steady_clock::now(); }
+	void stop() { __elapsed += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - __start).count(); }
+	double elapsed_ns() const { return __elapsed; }
+
+private:
+	std::chrono::steady_clock::time_point __start;
+	double __elapsed;
+};
+
+struct benchResult
+{
+	std::string op;
+	std::string table;
+	std::string key;
+	std::size_t size;
+	std::size_t ops;
+	double ns_per_op;
+};
+
+class benchRunner
+{
+public:
+	// recognises --json=<file>, --filter=<substring> and --max-size=<n>
+	benchRunner(int argc, char** argv, std::size_t default_max_size)
+		: __max_size(default_max_size), __header(false)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			if(std::strncmp(argv[i], "--json=", 7) == 0)
+				__json = argv[i] + 7;
+			else if(std::strncmp(argv[i], "--filter=", 9) == 0)
+				__filter = argv[i] + 9;
+			else if(std::strncmp(argv[i], "--max-size=", 11) == 0)
+				__max_size = std::strtoull(argv[i] + 11, nullptr, 10);
+			else
+				std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+		}
+	}
+
+	~benchRunner()
+	{
+		if(!__json.empty())
+			__write_json();
+	}
+
+	std::size_t max_size() const { return __max_size; }
+
+	// whether a benchmark of this name should run at all
+	bool selected(const std::string& name) const
+	{ return __filter.empty() || name.find(__filter) != std::string::npos; }
+
+	// run body until about a million operations or `repeats` runs have
+	// been timed, whichever comes first, and keep the fastest
+	template<class F>
+	void run(const char* op, const char* table, const char* key, std::size_t size, F body, int repeats = 10)
+	{
+		std::string name = std::string(op) + "/" + table + "/" + key + "/" + std::to_string(size);
+		if(!selected(name))
+			return;
+		if(!__header)
+		{
+			std::printf("%-10s %-16s %-8s %10s %12s\n", "op", "table", "key", "size", "ns/op");
+			__header = true;
+		}
+
+		double best = 1e300;
+		std::size_t ops = 0, total = 0;
+		for(int r = 0; r < repeats && (r == 0 || total < 1000000); ++r)
+		{
+			benchTimer timer;
+			ops = body(timer);
+			total += ops;
+			double ns = ops ? timer.elapsed_ns() / ops : 0;
+			best = std::min(best, ns);
+		}
+
+		benchResult result = { op, table, key, size, ops, best };
+		__results.push_back(result);
+		std::printf("%-10s %-16s %-8s %10zu %12.2f\n", op, table, key, size, best);
+		std::fflush(stdout);
+	}
+
+private:
+	void __write_json() const
+	{
+		FILE* out = std::fopen(__json.c_str(), "w");
+		if(!out)
+		{
+			std::fprintf(stderr, "cannot write %s\n", __json.c_str());
+			return;
+		}
+		std::fprintf(out, "{\n  \"context\": {\n");
+#ifdef __VERSION__
+		std::fprintf(out, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+#ifdef NDEBUG
+		std::fprintf(out, "    \"ndebug\": true,\n");
+#else
+		std::fprintf(out, "    \"ndebug\": false,\n");
+#endif
+		std::fprintf(out, "    \"max_size\": %zu\n  },\n  \"benchmarks\": [\n", __max_size);
+		for(std::size_t i = 0; i < __results.size(); ++i)
+		{
+			const benchResult& r = __results[i];
+			std::fprintf(out,
+				"    {\"name\": \"%s/%s/%s/%zu\", \"op\": \"%s\", \"table\": \"%s\", \"key\": \"%s\", "
+				"\"size\": %zu, \"ops\": %zu, \"ns_per_op\": %.3f}%s\n",
+				r.op.c_str(), r.table.c_str(), r.key.c_str(), r.size,
+				r.op.c_str(), r.table.c_str(), r.key.c_str(), r.size, r.ops, r.ns_per_op,
+				i + 1 < __results.size() ? "," : "");
+		}
+		std::fprintf(out, "  ]\n}\n");
+		std::fclose(out);
+	}
+
+	std::string __json;
+	std::string __filter;
+	std::size_t __max_size;
+	bool __header;
+	std::vector<benchResult> __results;
+};
+
+// keep the optimiser from discarding a value
+template<class T>
+inline void bench_keep(const T& value)
+{ asm volatile("" : : "r,m"(value) : "memory"); }
+
+#endif // __BENCH_HARNESS_H__
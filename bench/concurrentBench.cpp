@@ -0,0 +1,101 @@
+// Throughput of concurrent_hashTable against a mutex wrapped hashTable
+// from one thread up to the core count (or argv[1] threads).
+//
+// Every thread runs the same read-mostly mix: 90% find, 5% insert_or_assign
+// and 5% erase over a prefilled key range.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../hashTable.hpp"
+#include "../concurrentHashTable.hpp"
+
+typedef std::uint64_t key_t_;
+
+enum { KEYS = 1 << 20, OPS_PER_THREAD = 1 << 20 };
+
+struct locked_table
+{
+	bool find(key_t_ k, key_t_& out)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		hashTable<key_t_, key_t_>::iterator it = t.find(k);
+		if(it == t.end())
+			return false;
+		out = it->second;
+		return true;
+	}
+	void insert_or_assign(key_t_ k, key_t_ v)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		t.insert_or_assign(k, v);
+	}
+	void erase(key_t_ k)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		t.erase(k);
+	}
+
+	std::mutex m;
+	hashTable<key_t_, key_t_> t;
+};
+
+template<class Table>
+static void worker(Table& table, unsigned seed, std::size_t* found)
+{
+	std::mt19937_64 rng(seed);
+	key_t_ out = 0;
+	std::size_t hits = 0;
+	for(int i = 0; i < OPS_PER_THREAD; ++i)
+	{
+		key_t_ r = rng();
+		key_t_ k = r % (2 * KEYS);
+		unsigned op = static_cast<unsigned>(r >> 56) % 100;
+		if(op < 90)
+			hits += table.find(k, out);
+		else if(op < 95)
+			table.insert_or_assign(k, r);
+		else
+			table.erase(k);
+	}
+	*found = hits;
+}
+
+template<class Table>
+static double run(unsigned threads)
+{
+	Table table;
+	for(key_t_ k = 0; k < KEYS; ++k)
+		table.insert_or_assign(k * 2, k);
+
+	std::vector<std::thread> pool;
+	std::vector<std::size_t> found(threads);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(unsigned t = 0; t < threads; ++t)
+		pool.push_back(std::thread(worker<Table>, std::ref(table), t + 1, &found[t]));
+	for(unsigned t = 0; t < threads; ++t)
+		pool[t].join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return threads * double(OPS_PER_THREAD) / seconds / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+	if(max_threads == 0)
+		max_threads = 1;
+	std::printf("%8s %16s %16s\n", "threads", "concurrent Mops", "mutex Mops");
+	for(unsigned threads = 1; threads <= max_threads; threads *= 2)
+	{
+		double concurrent = run<concurrent_hashTable<key_t_, key_t_> >(threads);
+		double locked = run<locked_table>(threads);
+		std::printf("%8u %16.2f %16.2f\n", threads, concurrent, locked);
+		if(threads < max_threads && threads * 2 > max_threads)
+			threads = max_threads / 2;
+	}
+	return 0;
+}
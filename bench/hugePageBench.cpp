@@ -0,0 +1,91 @@
+// Random find latency on tables far larger than the last level cache, with
+// std::allocator and with huge_page_allocator.
+//
+// Every mapped value is the index of the key to look up next, so each find
+// waits for the one before it and the time per find is its full latency,
+// TLB misses included. AnonHugePages is how much of the process is backed by
+// transparent huge pages once the table is built; with the kernel setting
+// at "never" it stays 0 and both allocators should time the same.
+//
+// usage: hugePageBench [keys], 1 << 23 by default
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../hashTable.hpp"
+#include "../hugePageAllocator.hpp"
+
+typedef std::uint64_t key_t_;
+
+enum { LOOKUPS = 1 << 22 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// kB of anonymous memory on transparent huge pages, 0 where unknown
+static long anon_huge_kb()
+{
+	std::FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+	if(!f)
+		return 0;
+	char line[256];
+	long kb = 0;
+	while(std::fgets(line, sizeof(line), f))
+		if(std::strncmp(line, "AnonHugePages:", 14) == 0)
+			kb = std::strtol(line + 14, nullptr, 10);
+	std::fclose(f);
+	return kb;
+}
+
+template<class Policy, class Alloc>
+static void run(const char* layout, const char* alloc_name, const Alloc& alloc, const std::vector<key_t_>& keys)
+{
+	typedef hashTable<key_t_, key_t_, std::hash<key_t_>, std::equal_to<key_t_>, Alloc, Policy> table_type;
+	table_type table(keys.size(), std::hash<key_t_>(), std::equal_to<key_t_>(), alloc);
+	// key i leads to key next[i], one random cycle through all of them
+	std::vector<std::size_t> order(keys.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), std::mt19937_64(7));
+	for(std::size_t i = 0; i < order.size(); ++i)
+		table.try_emplace(keys[order[i]], order[(i + 1) % order.size()]);
+	long huge_kb = anon_huge_kb();
+
+	key_t_ key = keys[order[0]];
+	double start = now_ns();
+	for(std::size_t i = 0; i < LOOKUPS; ++i)
+		key = keys[table.find(key)->second];
+	double find_ns = (now_ns() - start) / LOOKUPS;
+
+	std::printf("%-8s %-10s %10.2f %14ld %22llu\n", layout, alloc_name, find_ns, huge_kb / 1024,
+		static_cast<unsigned long long>(key));
+}
+
+template<class Policy>
+static void run_allocators(const char* layout, const std::vector<key_t_>& keys)
+{
+	typedef pair<const key_t_, key_t_> value_type;
+	run<Policy>(layout, "std", std::allocator<value_type>(), keys);
+	run<Policy>(layout, "huge", huge_page_allocator<value_type>(), keys);
+	run<Policy>(layout, "hugetlb", huge_page_allocator<value_type>(huge_page_options::explicit_pages()), keys);
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t(1) << 23;
+	std::mt19937_64 rng(12345);
+	std::vector<key_t_> keys(count);
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		keys[i] = rng();
+
+	std::printf("%-8s %-10s %10s %14s %22s\n", "layout", "allocator", "find/ns", "hugepages/MB", "last key");
+	run_allocators<huge_page_chained_policy>("chained", keys);
+	run_allocators<open_addressing_policy>("flat", keys);
+	return 0;
+}
@@ -0,0 +1,91 @@
+// Bucket index policies for chained storage on integer and string keys.
+//
+// Each table grows from empty, so inserts include every rehash, then is
+// timed on successful and failed finds.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "../hashTable.hpp"
+
+enum { KEYS = 1 << 20 };
+
+struct prime_policy : chained_policy { typedef prime_index bucket_index; };
+struct pow2_policy : chained_policy { typedef pow2_index bucket_index; };
+struct fastrange_policy : chained_policy { typedef fastrange_index bucket_index; };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Key, class Policy>
+static void run(const char* keys_name, const char* name, const std::vector<Key>& keys, const std::vector<Key>& misses)
+{
+	typedef hashTable<Key, std::uint32_t, std::hash<Key>, std::equal_to<Key>,
+		std::allocator<pair<const Key, std::uint32_t> >, Policy> table_type;
+	table_type table;
+
+	double start = now_ns();
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		table.try_emplace(keys[i], static_cast<std::uint32_t>(i));
+	double insert_ns = (now_ns() - start) / keys.size();
+
+	std::size_t found = 0;
+	start = now_ns();
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		found += table.count(keys[i]);
+	double hit_ns = (now_ns() - start) / keys.size();
+
+	start = now_ns();
+	for(std::size_t i = 0; i < misses.size(); ++i)
+		found += table.count(misses[i]);
+	double miss_ns = (now_ns() - start) / misses.size();
+
+	std::printf("%-8s %-10s %10.2f %10.2f %10.2f %12zu\n",
+		keys_name, name, insert_ns, hit_ns, miss_ns, found);
+}
+
+template<class Key>
+static void run_all(const char* keys_name, const std::vector<Key>& keys, const std::vector<Key>& misses)
+{
+	run<Key, prime_policy>(keys_name, "prime", keys, misses);
+	run<Key, pow2_policy>(keys_name, "pow2", keys, misses);
+	run<Key, fastrange_policy>(keys_name, "fastrange", keys, misses);
+}
+
+int main()
+{
+	std::mt19937_64 rng(12345);
+	std::printf("%-8s %-10s %10s %10s %10s %12s\n",
+		"keys", "index", "insert/ns", "hit/ns", "miss/ns", "found");
+
+	// sequential integers are the worst case for an identity std::hash, and
+	// the best case for prime modulo, which keeps them in order
+	std::vector<std::uint64_t> ints(KEYS), int_misses(KEYS);
+	for(std::size_t i = 0; i < ints.size(); ++i)
+	{
+		ints[i] = i;
+		int_misses[i] = KEYS + i;
+	}
+	run_all("int", ints, int_misses);
+
+	for(std::size_t i = 0; i < ints.size(); ++i)
+	{
+		ints[i] = rng() | 1;
+		int_misses[i] = rng() & ~std::uint64_t(1);
+	}
+	run_all("rand-int", ints, int_misses);
+
+	std::vector<std::string> strings(KEYS), string_misses(KEYS);
+	for(std::size_t i = 0; i < strings.size(); ++i)
+	{
+		strings[i] = "key-" + std::to_string(rng());
+		string_misses[i] = "miss-" + std::to_string(rng());
+	}
+	run_all("string", strings, string_misses);
+	return 0;
+}
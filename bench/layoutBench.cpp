@@ -0,0 +1,73 @@
+// Chained vs open addressing layout at fixed load factors.
+//
+// Each table is sized up front so that it holds CAPACITY * load factor
+// keys without rehashing, then timed on inserts, successful finds and
+// failed finds.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+typedef hashTable<key_t_, key_t_> chained_table;
+typedef hashTable<key_t_, key_t_, std::hash<key_t_>, std::equal_to<key_t_>,
+	std::allocator<pair<const key_t_, key_t_> >, open_addressing_policy> flat_table;
+
+enum { CAPACITY = 1 << 20 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Table>
+static void run(const char* name, float load, const std::vector<key_t_>& keys, const std::vector<key_t_>& misses)
+{
+	Table table(CAPACITY);
+	table.max_load_factor(0.95f);
+	table.rehash(CAPACITY);
+
+	double start = now_ns();
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		table.try_emplace(keys[i], i);
+	double insert_ns = (now_ns() - start) / keys.size();
+
+	std::size_t found = 0;
+	start = now_ns();
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		found += table.count(keys[i]);
+	double hit_ns = (now_ns() - start) / keys.size();
+
+	start = now_ns();
+	for(std::size_t i = 0; i < misses.size(); ++i)
+		found += table.count(misses[i]);
+	double miss_ns = (now_ns() - start) / misses.size();
+
+	std::printf("%-8s %5.2f %10.2f %10.2f %10.2f %12zu\n",
+		name, load, insert_ns, hit_ns, miss_ns, found);
+}
+
+int main()
+{
+	std::mt19937_64 rng(12345);
+	std::printf("%-8s %5s %10s %10s %10s %12s\n",
+		"layout", "load", "insert/ns", "hit/ns", "miss/ns", "found");
+	for(int percent = 50; percent <= 90; percent += 10)
+	{
+		float load = percent / 100.0f;
+		std::vector<key_t_> keys(static_cast<std::size_t>(CAPACITY * load));
+		std::vector<key_t_> misses(keys.size());
+		// odd keys are inserted and even keys are looked up as misses
+		for(std::size_t i = 0; i < keys.size(); ++i)
+		{
+			keys[i] = rng() | 1;
+			misses[i] = rng() & ~key_t_(1);
+		}
+		run<chained_table>("chained", load, keys, misses);
+		run<flat_table>("flat", load, keys, misses);
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+// hashTable (every layout) against std::unordered_map.
+//
+// For every key type and size from 1K up to --max-size (default 1M, the
+// largest is 100M) this times insert into an empty table, successful
+// and failed find, erase of every key, a full iteration, and a rehash to
+// twice the bucket count. All numbers are ns per element. Pass
+// --json=<file> to record the results, e.g. to compare releases.
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "benchHarness.hpp"
+#include "../hashTable.hpp"
+
+template<class Key>
+struct keyTraits;
+
+// keys are an odd multiplier times even numbers and misses times odd
+// numbers; the multiplication is a bijection, so the two sets never meet
+template<>
+struct keyTraits<std::uint32_t>
+{
+	static const char* name() { return "int"; }
+	static std::uint32_t make(std::size_t i) { return static_cast<std::uint32_t>(i) * 2654435761u; }
+};
+
+template<>
+struct keyTraits<std::uint64_t>
+{
+	static const char* name() { return "uint64"; }
+	static std::uint64_t make(std::size_t i) { return static_cast<std::uint64_t>(i) * 0x9e3779b97f4a7c15ULL; }
+};
+
+template<>
+struct keyTraits<std::string>
+{
+	static const char* name() { return "string"; }
+	static std::string make(std::size_t i) { return "key:" + std::to_string(keyTraits<std::uint64_t>::make(i)); }
+};
+
+template<class Key>
+struct chained_map
+{
+	typedef hashTable<Key, std::uint64_t> type;
+	static const char* name() { return "hashTable"; }
+};
+
+template<class Key>
+struct flat_map
+{
+	typedef hashTable<Key, std::uint64_t, std::hash<Key>, std::equal_to<Key>,
+		std::allocator<pair<const Key, std::uint64_t> >, open_addressing_policy> type;
+	static const char* name() { return "hashTable-flat"; }
+};
+
+template<class Key>
+struct dense_map
+{
+	typedef hashTable<Key, std::uint64_t, std::hash<Key>, std::equal_to<Key>,
+		std::allocator<pair<const Key, std::uint64_t> >, dense_policy> type;
+	static const char* name() { return "hashTable-dense"; }
+};
+
+template<class Key>
+struct std_map
+{
+	typedef std::unordered_map<Key, std::uint64_t> type;
+	static const char* name() { return "unordered_map"; }
+};
+
+template<class Table, class Key>
+static void fill(Table& table, const std::vector<Key>& keys)
+{
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		table.emplace(keys[i], i);
+}
+
+template<template<class> class Map, class Key>
+static void run_table(benchRunner& runner, std::size_t size,
+	const std::vector<Key>& keys, const std::vector<Key>& shuffled, const std::vector<Key>& misses)
+{
+	typedef typename Map<Key>::type table_type;
+	const char* table = Map<Key>::name();
+	const char* key = keyTraits<Key>::name();
+
+	runner.run("insert", table, key, size, [&](benchTimer& timer)
+	{
+		table_type t;
+		timer.start();
+		fill(t, keys);
+		timer.stop();
+		return keys.size();
+	});
+
+	table_type built;
+	fill(built, keys);
+
+	runner.run("find-hit", table, key, size, [&](benchTimer& timer)
+	{
+		std::size_t found = 0;
+		timer.start();
+		for(std::size_t i = 0; i < shuffled.size(); ++i)
+			found += built.find(shuffled[i]) != built.end();
+		timer.stop();
+		bench_keep(found);
+		return shuffled.size();
+	});
+
+	runner.run("find-miss", table, key, size, [&](benchTimer& timer)
+	{
+		std::size_t found = 0;
+		timer.start();
+		for(std::size_t i = 0; i < misses.size(); ++i)
+			found += built.find(misses[i]) != built.end();
+		timer.stop();
+		bench_keep(found);
+		return misses.size();
+	});
+
+	runner.run("iterate", table, key, size, [&](benchTimer& timer)
+	{
+		std::uint64_t sum = 0;
+		timer.start();
+		for(typename table_type::const_iterator it = built.begin(); it != built.end(); ++it)
+			sum += it->second;
+		timer.stop();
+		bench_keep(sum);
+		return built.size();
+	});
+
+	runner.run("erase", table, key, size, [&](benchTimer& timer)
+	{
+		table_type t;
+		fill(t, keys);
+		timer.start();
+		for(std::size_t i = 0; i < shuffled.size(); ++i)
+			t.erase(shuffled[i]);
+		timer.stop();
+		return shuffled.size();
+	});
+
+	runner.run("rehash", table, key, size, [&](benchTimer& timer)
+	{
+		table_type t;
+		fill(t, keys);
+		timer.start();
+		t.rehash(t.bucket_count() * 2);
+		timer.stop();
+		return t.size();
+	});
+}
+
+template<class Key>
+static void run_key(benchRunner& runner)
+{
+	for(std::size_t size = 1000; size <= runner.max_size() && size <= 100000000; size *= 10)
+	{
+		std::vector<Key> keys(size), misses(size);
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			keys[i] = keyTraits<Key>::make(2 * i);
+			misses[i] = keyTraits<Key>::make(2 * i + 1);
+		}
+		std::vector<Key> shuffled(keys);
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(size));
+
+		run_table<std_map>(runner, size, keys, shuffled, misses);
+		run_table<chained_map>(runner, size, keys, shuffled, misses);
+		run_table<flat_map>(runner, size, keys, shuffled, misses);
+		run_table<dense_map>(runner, size, keys, shuffled, misses);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	benchRunner runner(argc, argv, 1000000);
+	run_key<std::uint32_t>(runner);
+	run_key<std::uint64_t>(runner);
+	run_key<std::string>(runner);
+	return 0;
+}
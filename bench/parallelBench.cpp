@@ -0,0 +1,78 @@
+// Building a table from a range and rehashing it with 1, 2, 4, ... threads
+// up to the number of cores.
+//
+// The first row of each layout is the plain insert(first, last). Pass the
+// number of keys as the first argument (default 4M); the parallel split
+// only starts at thread_count::PARALLEL_GRAIN keys per thread.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+typedef pair<key_t_, key_t_> item_t;
+
+enum { ROUNDS = 3 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Policy>
+static void run(const char* name, const std::vector<item_t>& items, unsigned max_threads)
+{
+	typedef hashTable<key_t_, key_t_, std::hash<key_t_>, std::equal_to<key_t_>,
+		std::allocator<pair<const key_t_, key_t_> >, Policy> table_type;
+
+	// threads == 0 is the sequential baseline
+	for(unsigned threads = 0; threads <= max_threads; threads = threads ? threads * 2 : 1)
+	{
+		double build_ns = 1e300, rehash_ns = 1e300;
+		for(int round = 0; round < ROUNDS; ++round)
+		{
+			double start = now_ns();
+			table_type table = threads
+				? table_type(items.begin(), items.end(), thread_count(threads))
+				: table_type(items.begin(), items.end());
+			double ns = (now_ns() - start) / items.size();
+			build_ns = ns < build_ns ? ns : build_ns;
+
+			start = now_ns();
+			if(threads)
+				table.rehash(table.bucket_count() * 2, thread_count(threads));
+			else
+				table.rehash(table.bucket_count() * 2);
+			ns = (now_ns() - start) / items.size();
+			rehash_ns = ns < rehash_ns ? ns : rehash_ns;
+		}
+		if(threads)
+			std::printf("%-8s %8u %10.2f %10.2f\n", name, threads, build_ns, rehash_ns);
+		else
+			std::printf("%-8s %8s %10.2f %10.2f\n", name, "seq", build_ns, rehash_ns);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t(1) << 22;
+	unsigned cores = std::thread::hardware_concurrency();
+	if(cores == 0)
+		cores = 1;
+
+	std::mt19937_64 rng(12345);
+	std::vector<item_t> items(keys);
+	for(std::size_t i = 0; i < items.size(); ++i)
+		items[i] = item_t(rng(), i);
+
+	std::printf("%-8s %8s %10s %10s\n", "layout", "threads", "build/ns", "rehash/ns");
+	run<chained_policy>("chained", items, cores);
+	run<open_addressing_policy>("flat", items, cores);
+	run<dense_policy>("dense", items, cores);
+	return 0;
+}
@@ -0,0 +1,59 @@
+// Per node allocation vs the slab pool under insert/erase churn.
+//
+// A table of LIVE keys is kept steady while a sliding window inserts one
+// new key and erases the oldest, then the whole table is cleared. Both
+// phases are timed per element.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+
+enum { LIVE = 1 << 16, CHURN = 1 << 22, ROUNDS = 5 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Policy>
+static void run(const char* name)
+{
+	typedef hashTable<key_t_, std::string, std::hash<key_t_>, std::equal_to<key_t_>,
+		std::allocator<pair<const key_t_, std::string> >, Policy> table_type;
+
+	double churn_ns = 0, clear_ns = 0;
+	std::size_t checksum = 0;
+	for(int round = 0; round < ROUNDS; ++round)
+	{
+		table_type table;
+		table.reserve(LIVE);
+		for(key_t_ k = 0; k < LIVE; ++k)
+			table.try_emplace(k, "v");
+
+		double start = now_ns();
+		for(key_t_ k = LIVE; k < LIVE + CHURN; ++k)
+		{
+			table.try_emplace(k, "v");
+			checksum += table.erase(k - LIVE);
+		}
+		churn_ns += (now_ns() - start) / CHURN;
+
+		start = now_ns();
+		table.clear();
+		clear_ns += (now_ns() - start) / LIVE;
+	}
+
+	std::printf("%-8s %10.2f %10.2f %12zu\n", name, churn_ns / ROUNDS, clear_ns / ROUNDS, checksum);
+}
+
+int main()
+{
+	std::printf("%-8s %10s %10s %12s\n", "nodes", "churn/ns", "clear/ns", "erased");
+	run<chained_policy>("malloc");
+	run<pooled_chained_policy>("pooled");
+	return 0;
+}
@@ -0,0 +1,92 @@
+// Cost of relocating elements on resize, trivially relocatable or not.
+//
+// pod and moved hold the same 32 bytes, but moved declares its own move
+// constructor, so it is moved element by element where pod is copied with
+// memcpy. string pays for a real move. Each table is filled with KEYS
+// elements and then rehashed to twice its bucket count; dense storage also
+// relocates its value array when it grows.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+
+struct pod
+{
+	pod() : words() {}
+	explicit pod(std::size_t i) : words() { words[0] = i; }
+
+	std::uint64_t words[4];
+};
+
+struct moved
+{
+	moved() : words() {}
+	explicit moved(std::size_t i) : words() { words[0] = i; }
+	moved(const moved& other) { for(int i = 0; i < 4; ++i) words[i] = other.words[i]; }
+	moved(moved&& other) noexcept { for(int i = 0; i < 4; ++i) words[i] = other.words[i]; }
+	moved& operator=(const moved&) = default;
+
+	std::uint64_t words[4];
+};
+
+enum { KEYS = 1 << 20, ROUNDS = 5 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static pod make(pod*, std::size_t i) { return pod(i); }
+static moved make(moved*, std::size_t i) { return moved(i); }
+static std::string make(std::string*, std::size_t i) { return std::string(24, char('a' + i % 26)); }
+
+template<class Policy, class Payload>
+static void run(const char* layout, const char* payload)
+{
+	typedef hashTable<key_t_, Payload, std::hash<key_t_>, std::equal_to<key_t_>,
+		std::allocator<pair<const key_t_, Payload> >, Policy> table_type;
+
+	// best of ROUNDS, the runs are short enough to be noisy
+	double rehash_ns = 1e300, insert_ns = 1e300;
+	std::size_t checksum = 0;
+	for(int round = 0; round < ROUNDS; ++round)
+	{
+		table_type table;
+		double start = now_ns();
+		for(std::size_t i = 0; i < KEYS; ++i)
+			table.try_emplace(key_t_(i) * 0x9e3779b97f4a7c15ull, make(static_cast<Payload*>(nullptr), i));
+		double ns = (now_ns() - start) / KEYS;
+		insert_ns = ns < insert_ns ? ns : insert_ns;
+
+		start = now_ns();
+		table.rehash(table.bucket_count() * 2);
+		ns = (now_ns() - start) / KEYS;
+		rehash_ns = ns < rehash_ns ? ns : rehash_ns;
+		checksum += table.size();
+	}
+
+	std::printf("%-8s %-8s %10d %12.2f %10.2f %12zu\n", layout, payload,
+		int(is_trivially_relocatable<pair<const key_t_, Payload> >::value), insert_ns, rehash_ns, checksum);
+}
+
+template<class Policy>
+static void run_payloads(const char* layout)
+{
+	run<Policy, pod>(layout, "pod");
+	run<Policy, moved>(layout, "moved");
+	run<Policy, std::string>(layout, "string");
+}
+
+int main()
+{
+	std::printf("%-8s %-8s %10s %12s %10s %12s\n", "layout", "payload", "memcpy", "insert/ns", "rehash/ns", "checksum");
+	run_payloads<open_addressing_policy>("flat");
+	run_payloads<dense_policy>("dense");
+	run_payloads<soa_policy>("soa");
+	return 0;
+}
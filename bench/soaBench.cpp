@@ -0,0 +1,87 @@
+// Flat vs structure of arrays storage with small keys and large values.
+//
+// Keys are uint64 and values 256 bytes. Hits read one word of the value
+// they find, misses read none, so the gap between the layouts is the
+// value bytes flat storage drags through the cache while probing.
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef std::uint64_t key_t_;
+
+struct payload
+{
+	payload() : words() {}
+	explicit payload(std::size_t i) : words() { words[0] = i; }
+
+	std::uint64_t words[32];
+};
+
+enum { KEYS = 1 << 18, LOOKUPS = 1 << 20, ROUNDS = 5 };
+
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class Policy>
+static void run(const char* name, const std::vector<key_t_>& keys,
+	const std::vector<key_t_>& hits, const std::vector<key_t_>& misses)
+{
+	typedef hashTable<key_t_, payload, std::hash<key_t_>, std::equal_to<key_t_>,
+		std::allocator<pair<const key_t_, payload> >, Policy> table_type;
+	table_type table;
+	table.reserve(keys.size());
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		table.try_emplace(keys[i], i);
+
+	// best of ROUNDS, the runs are short enough to be noisy
+	std::uint64_t sum = 0;
+	double hit_ns = 1e300, miss_ns = 1e300, keys_ns = 1e300;
+	for(int round = 0; round < ROUNDS; ++round)
+	{
+		double start = now_ns();
+		for(std::size_t i = 0; i < hits.size(); ++i)
+			sum += table.find(hits[i])->second.words[0];
+		double ns = (now_ns() - start) / hits.size();
+		hit_ns = ns < hit_ns ? ns : hit_ns;
+
+		start = now_ns();
+		for(std::size_t i = 0; i < misses.size(); ++i)
+			sum += table.count(misses[i]);
+		ns = (now_ns() - start) / misses.size();
+		miss_ns = ns < miss_ns ? ns : miss_ns;
+
+		// a pass that only looks at keys
+		start = now_ns();
+		for(typename table_type::const_iterator it = table.cbegin(); it != table.cend(); ++it)
+			sum += it->first;
+		ns = (now_ns() - start) / table.size();
+		keys_ns = ns < keys_ns ? ns : keys_ns;
+	}
+
+	std::printf("%-8s %10.2f %10.2f %10.2f %22llu\n", name, hit_ns, miss_ns, keys_ns,
+		static_cast<unsigned long long>(sum));
+}
+
+int main()
+{
+	std::mt19937_64 rng(12345);
+	std::vector<key_t_> keys(KEYS), hits(LOOKUPS), misses(LOOKUPS);
+	for(std::size_t i = 0; i < keys.size(); ++i)
+		keys[i] = rng() | 1;
+	for(std::size_t i = 0; i < hits.size(); ++i)
+	{
+		hits[i] = keys[rng() % keys.size()];
+		misses[i] = rng() & ~key_t_(1);
+	}
+
+	std::printf("%-8s %10s %10s %10s %22s\n", "layout", "hit/ns", "miss/ns", "keys/ns", "checksum");
+	run<open_addressing_policy>("flat", keys, hits, misses);
+	run<soa_policy>("soa", keys, hits, misses);
+	return 0;
+}
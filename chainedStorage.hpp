@@ -0,0 +1,1096 @@
+#ifndef __CHAINED_STORAGE_H__
+#define __CHAINED_STORAGE_H__
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "nodeHandle.hpp"
+#include "nodePool.hpp"
+#include "parallel.hpp"
+#include "tableStats.hpp"
+
+// whether Hash is cheap enough that caching it buys nothing: std::hash of
+// an arithmetic, enum or pointer key
+template<class Key, class Hash>
+struct __fast_hash : std::integral_constant<bool,
+	std::is_same<Hash, std::hash<Key> >::value
+	&& (std::is_arithmetic<Key>::value || std::is_enum<Key>::value || std::is_pointer<Key>::value)> {};
+
+// the part of a node that remembers its key's full hash, or nothing when
+// hashes are not cached
+template<bool Cache>
+struct __nodeHash
+{
+	void store_hash(std::size_t) {}
+	void copy_hash(const __nodeHash&) {}
+	bool hash_may_equal(std::size_t) const { return true; }
+	template<class Hash, class Key>
+	std::size_t load_hash(const Hash& hash, const Key& key) const { return hash(key); }
+};
+
+template<>
+struct __nodeHash<true>
+{
+	void store_hash(std::size_t h) { hash = h; }
+	void copy_hash(const __nodeHash& other) { hash = other.hash; }
+	bool hash_may_equal(std::size_t h) const { return hash == h; }
+	template<class Hash, class Key>
+	std::size_t load_hash(const Hash&, const Key&) const { return hash; }
+
+	std::size_t hash;
+};
+
+// Separate chaining storage: an array of bucket heads, each bucket a singly
+// linked list of heap allocated hashNodes.
+//
+// With Policy::INCREMENTAL_REHASH a rehash only allocates the new bucket
+// array. The old one stays alive and every insert moves the next
+// Policy::REHASH_STEP old buckets across, so no single call pays for the
+// whole table. Until the move is done lookups check both arrays, and
+// iteration and the bucket interface take the remaining old buckets
+// before the new ones. Erasing never moves elements, so erase loops stay
+// valid either way; an insert during a migration may invalidate
+// iterators, like any rehash.
+//
+// With Policy::NODE_POOL nodes come from a nodePool instead of one
+// allocator call each; erased nodes are recycled and clear() hands whole
+// slabs back.
+//
+// With Policy::CACHE_HASH each node also keeps its key's full hash, so
+// rehashing never calls Hash and chain walks only call KeyEqual on nodes
+// whose hash matches. The default, -1, caches unless __fast_hash holds.
+//
+// With Policy::STATS lookups, inserts, rehashes and allocations feed a
+// statsRecorder; without it the recorder is empty.
+//
+// Parallel rehashes and builds split the buckets into one range per
+// thread. Each thread first sorts its share of the nodes into a list per
+// destination range, then each thread links the lists for its own range,
+// so no bucket is ever written by two threads. A parallel rehash finishes
+// any incremental migration; pooled nodes are always built on one thread.
+//
+// extract, insert_node and merge unlink nodes from one table and link them
+// into another as they are, keeping their cached hash when Hash has no
+// state that could make the two tables disagree. Pooled nodes belong to
+// their table's slabs, so with NODE_POOL elements are moved into fresh
+// nodes instead.
+//
+// With a Hash that has reseed(), such as seeded_hash, an insert that makes
+// a chain longer than Policy::RESEED_CHAIN draws a new seed and relinks
+// every node under it. Hashes a batch computed before that are stale, so
+// once a table has reseeded try_emplace_hashed hashes its key again. To
+// bound the cost under a hash that stays bad, the table reseeds again only
+// once it has doubled in size. Such a Hash must not throw.
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class chainedStorage
+{
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	enum
+	{
+		CACHE_HASH = Policy::CACHE_HASH < 0 ? !__fast_hash<Key, Hash>::value : Policy::CACHE_HASH != 0,
+		RESEED = Policy::RESEED_CHAIN > 0 && __is_reseedable<Hash>::value
+	};
+
+	// Node
+	struct hashNode : __nodeHash<CACHE_HASH>
+	{
+		template<class... Args>
+		explicit hashNode(Args&&... args)
+			: value(::forward<Args>(args)...), next(nullptr) {}
+
+		value_type value;
+		hashNode* next;
+	}; // End Node
+
+	// an element and the bucket it is chained in; while migrating, buckets
+	// below __old_count are in the old array and the rest in the new one
+	struct position
+	{
+		hashNode* node;
+		size_type bucket;
+
+		bool operator==(const position& other) const { return node == other.node; }
+		bool operator!=(const position& other) const { return node != other.node; }
+	};
+	typedef hashNode* local_position;
+	typedef hashNode node;
+
+	chainedStorage(size_type bucket_count, const hasher& hash,
+		const key_equal& equal, const allocator_type& alloc)
+		: __hash(hash), __equal(equal), __node_alloc(alloc), __bucket_alloc(alloc),
+		  __buckets(nullptr), __bucket_count(0), __old_buckets(nullptr), __old_count(0), __migrated(0),
+		  __size(0), __desired_load_factor(1.0f), __reseed_size(0)
+		{ __allocate_buckets(bucket_count ? index_type::round(bucket_count) : 0); }
+
+	chainedStorage(const chainedStorage& other)
+		: chainedStorage(other, node_traits::select_on_container_copy_construction(other.__node_alloc)) {}
+	chainedStorage(const chainedStorage& other, const allocator_type& alloc)
+		: __hash(other.__hash), __equal(other.__equal), __node_alloc(alloc), __bucket_alloc(alloc),
+		  __buckets(nullptr), __bucket_count(0), __old_buckets(nullptr), __old_count(0), __migrated(0),
+		  __size(0), __desired_load_factor(other.__desired_load_factor),
+		  __floor(other.__floor.min_load_factor), __reseed_size(other.__reseed_size)
+	{
+		__allocate_buckets(other.__bucket_count);
+		try
+		{
+			for(size_type i = 0; i < other.__bucket_count; ++i)
+			{
+				hashNode** tail = __buckets + i;
+				for(hashNode* n = other.__buckets[i]; n; n = n->next)
+				{
+					*tail = __create_node(n->value);
+					(*tail)->copy_hash(*n);
+					tail = &(*tail)->next;
+					++__size;
+				}
+			}
+			// anything the other table has not migrated yet lands directly
+			// in its final bucket
+			for(size_type i = other.__migrated; i < other.__old_count; ++i)
+				for(hashNode* n = other.__old_buckets[i]; n; n = n->next)
+				{
+					hashNode* copy = __create_node(n->value);
+					copy->copy_hash(*n);
+					hashNode*& head = __buckets[__index(__node_hash(copy))];
+					copy->next = head;
+					head = copy;
+					++__size;
+				}
+		}
+		catch(...)
+		{
+			clear();
+			__deallocate_buckets();
+			throw;
+		}
+	}
+
+	chainedStorage(chainedStorage&& other) noexcept
+		: __hash(std::move(other.__hash)), __equal(std::move(other.__equal)),
+		  __node_alloc(std::move(other.__node_alloc)), __bucket_alloc(std::move(other.__bucket_alloc)),
+		  __pool(std::move(other.__pool)), __buckets(other.__buckets), __bucket_count(other.__bucket_count),
+		  __old_buckets(other.__old_buckets), __old_count(other.__old_count), __migrated(other.__migrated),
+		  __index(other.__index), __old_index(other.__old_index),
+		  __size(other.__size), __desired_load_factor(other.__desired_load_factor),
+		  __floor(other.__floor), __reseed_size(other.__reseed_size), __stats(other.__stats)
+	{
+		other.__buckets = nullptr;
+		other.__bucket_count = 0;
+		other.__old_buckets = nullptr;
+		other.__old_count = 0;
+		other.__migrated = 0;
+		other.__size = 0;
+	}
+	chainedStorage(chainedStorage&& other, const allocator_type& alloc)
+		: chainedStorage(0, other.__hash, other.__equal, alloc)
+	{
+		__desired_load_factor = other.__desired_load_factor;
+		__floor.min_load_factor = other.__floor.min_load_factor;
+		if(__node_alloc == other.__node_alloc)
+		{
+			swap(other);
+			return;
+		}
+		rehash(other.__size);
+		for(position p = other.first(); p != other.last(); other.advance(p))
+		{
+			size_type hash = other.__node_hash(p.node);
+			hashNode* n = __create_node(p.node->value.first,
+				std::move(p.node->value.second));
+			__link(n, hash);
+		}
+		other.clear();
+	}
+
+	~chainedStorage()
+	{
+		clear();
+		__deallocate_buckets();
+	}
+
+	void swap(chainedStorage& other) noexcept
+	{
+		using std::swap;
+		swap(__hash, other.__hash);
+		swap(__equal, other.__equal);
+		if(node_traits::propagate_on_container_swap::value)
+		{
+			swap(__node_alloc, other.__node_alloc);
+			swap(__bucket_alloc, other.__bucket_alloc);
+		}
+		__pool.swap(other.__pool);
+		swap(__buckets, other.__buckets);
+		swap(__bucket_count, other.__bucket_count);
+		swap(__old_buckets, other.__old_buckets);
+		swap(__old_count, other.__old_count);
+		swap(__index, other.__index);
+		swap(__old_index, other.__old_index);
+		swap(__migrated, other.__migrated);
+		swap(__size, other.__size);
+		swap(__desired_load_factor, other.__desired_load_factor);
+		swap(__floor, other.__floor);
+		swap(__reseed_size, other.__reseed_size);
+		swap(__stats, other.__stats);
+	}
+
+	size_type size() const noexcept { return __size; }
+	size_type max_size() const noexcept { return node_traits::max_size(__node_alloc); }
+	allocator_type get_allocator() const { return allocator_type(__node_alloc); }
+	hasher hash_function() const { return __hash; }
+	key_equal key_eq() const { return __equal; }
+
+	// ITERATION
+	position first() const
+	{
+		position p = { nullptr, 0 };
+		__skip_empty(p);
+		return p;
+	}
+	position last() const { return position{ nullptr, __old_count + __bucket_count }; }
+	void advance(position& p) const
+	{
+		if(p.node->next)
+			p.node = p.node->next;
+		else
+		{
+			++p.bucket;
+			__skip_empty(p);
+		}
+	}
+	value_type& value(position p) const { return p.node->value; }
+
+	// BUCKETS
+	// while a migration is under way buckets are numbered across both
+	// arrays, old first, as positions are, so every element is in exactly
+	// one bucket and bucket(key) is the one that holds key
+	size_type bucket_count() const { return __old_count + __bucket_count; }
+	size_type max_bucket_count() const { return bucket_traits::max_size(__bucket_alloc); }
+	size_type bucket(const key_type& key) const
+	{
+		size_type hash = __hash(key);
+		if(__old_buckets)
+		{
+			position p = __find(key, hash);
+			if(p != last())
+				return p.bucket;
+		}
+		return __old_count + __index(hash);
+	}
+	size_type bucket_size(size_type n) const
+	{
+		size_type count = 0;
+		for(hashNode* node = __head(n); node; node = node->next)
+			++count;
+		return count;
+	}
+	local_position local_first(size_type n) const { return __head(n); }
+	local_position local_last(size_type) const { return nullptr; }
+	void local_advance(local_position& p) const { p = p->next; }
+	value_type& local_value(local_position p) const { return p->value; }
+
+	// HASH POLICY
+	float max_load_factor() const { return __desired_load_factor; }
+
+	hashTableStats stats() const
+	{
+		hashTableStats s;
+		s.size = __size;
+		// while migrating the old array's buckets count too, as they do
+		// in bucket_count()
+		s.bucket_count = bucket_count();
+		s.load_factor = s.bucket_count ? float(__size) / s.bucket_count : 0.0f;
+		for(size_type i = 0; i < s.bucket_count; ++i)
+		{
+			size_type length = 0;
+			for(hashNode* n = __head(i); n; n = n->next)
+				++length;
+			++s.chain_histogram[hashTableStats::bin(length)];
+			if(length > s.max_chain)
+				s.max_chain = length;
+		}
+		__stats.fill(s);
+		return s;
+	}
+	void max_load_factor(float ml) { __desired_load_factor = ml; }
+	float min_load_factor() const { return __floor.min_load_factor; }
+	void min_load_factor(float ml) { __floor.min_load_factor = ml; }
+
+	hashTableMemory memory_usage() const
+	{
+		hashTableMemory m;
+		m.add_buckets(__bucket_count * sizeof(hashNode*));
+		m.add_buckets(__old_count * sizeof(hashNode*));
+		if(Policy::NODE_POOL)
+			m.add_elements(__pool.allocated_nodes() * sizeof(hashNode), __pool.slab_count());
+		else
+			m.add_elements(__size * sizeof(hashNode), __size);
+		return m;
+	}
+
+	void rehash(size_type count)
+	{
+		size_type needed = static_cast<size_type>(std::ceil(__size / __desired_load_factor));
+		if(count < needed)
+			count = needed;
+		count = index_type::round(count ? count : 1);
+		if(count == __bucket_count)
+			return;
+		typename stats_type::time_point start = __stats.rehash_begin();
+
+		if(Policy::INCREMENTAL_REHASH)
+		{
+			// at most one migration at a time
+			__migrate(__old_count);
+			__old_buckets = __buckets;
+			__old_count = __bucket_count;
+			__old_index = __index;
+			__migrated = 0;
+			__buckets = nullptr;
+			__bucket_count = 0;
+			try
+			{
+				__allocate_buckets(count);
+			}
+			catch(...)
+			{
+				__buckets = __old_buckets;
+				__bucket_count = __old_count;
+				__index = __old_index;
+				__old_buckets = nullptr;
+				__old_count = 0;
+				throw;
+			}
+			if(__size == 0)
+				__migrate(__old_count);
+			__stats.rehash_end(start);
+			return;
+		}
+
+		hashNode** old_buckets = __buckets;
+		size_type old_count = __bucket_count;
+		__buckets = nullptr;
+		try
+		{
+			__allocate_buckets(count);
+		}
+		catch(...)
+		{
+			// the count and index only change once the array exists
+			__buckets = old_buckets;
+			throw;
+		}
+		for(size_type i = 0; i < old_count; ++i)
+		{
+			hashNode* n = old_buckets[i];
+			while(n)
+			{
+				hashNode* next = n->next;
+				hashNode*& head = __buckets[__index(__node_hash(n))];
+				n->next = head;
+				head = n;
+				n = next;
+			}
+		}
+		bucket_traits::deallocate(__bucket_alloc, old_buckets, old_count);
+		__stats.rehash_end(start);
+	}
+
+	void rehash(size_type count, thread_count threads)
+	{
+		size_type needed = static_cast<size_type>(std::ceil(__size / __desired_load_factor));
+		if(count < needed)
+			count = needed;
+		count = index_type::round(count ? count : 1);
+		unsigned n = threads.for_size(__size);
+		if(n < 2)
+		{
+			rehash(count);
+			__migrate(__old_count);
+			return;
+		}
+		if(count == __bucket_count && !__old_buckets)
+			return;
+		typename stats_type::time_point start = __stats.rehash_begin();
+
+		index_type index;
+		index.reset(count);
+		size_type sources = __old_count + __bucket_count;
+		size_type span = (count + n - 1) / n;
+		std::vector<__nodeList> lists(n * n);
+		hashNode** buckets = bucket_traits::allocate(__bucket_alloc, count);
+		// __run_threads allocates too, so the new array is not ours to
+		// keep until both passes are through
+		try
+		{
+			__run_threads(n, [&](unsigned t)
+			{
+				for(size_type b = __chunk_begin(sources, t, n); b < __chunk_begin(sources, t + 1, n); ++b)
+					for(hashNode* node = __head(b); node; )
+					{
+						hashNode* next = node->next;
+						lists[t * n + index(__node_hash(node)) / span].push(node);
+						node = next;
+					}
+			});
+			__run_threads(n, [&](unsigned t)
+			{
+				size_type end = (t + 1) * span < count ? (t + 1) * span : count;
+				for(size_type b = t * span; b < end; ++b)
+					buckets[b] = nullptr;
+				for(unsigned s = 0; s < n; ++s)
+					for(hashNode* node = lists[s * n + t].head; node; )
+					{
+						hashNode* next = node->next;
+						hashNode*& head = buckets[index(__node_hash(node))];
+						node->next = head;
+						head = node;
+						node = next;
+					}
+			});
+		}
+		catch(...)
+		{
+			bucket_traits::deallocate(__bucket_alloc, buckets, count);
+			throw;
+		}
+
+		if(__old_buckets)
+			bucket_traits::deallocate(__bucket_alloc, __old_buckets, __old_count);
+		__old_buckets = nullptr;
+		__old_count = 0;
+		__migrated = 0;
+		__deallocate_buckets();
+		__buckets = buckets;
+		__bucket_count = count;
+		__index = index;
+		__stats.array_allocated();
+		__stats.rehash_end(start);
+	}
+
+	// insert every element of [first, last) that is not already present,
+	// the first of several equal keys winning as with insert()
+	template<class ForwardIt>
+	void insert_parallel(ForwardIt first, ForwardIt last, thread_count threads)
+	{
+		size_type count = static_cast<size_type>(std::distance(first, last));
+		unsigned n = threads.for_size(count);
+		if(n < 2 || Policy::NODE_POOL)
+		{
+			for(; first != last; ++first)
+				emplace(*first);
+			return;
+		}
+		rehash(static_cast<size_type>(std::ceil((__size + count) / __desired_load_factor)), threads);
+		__migrate(__old_count);
+
+		// build the nodes and sort them by destination range, keeping
+		// input order within each list
+		size_type span = (__bucket_count + n - 1) / n;
+		std::vector<__nodeList> lists(n * n);
+		try
+		{
+			__run_threads(n, [&](unsigned t)
+			{
+				size_type i = __chunk_begin(count, t, n), end = __chunk_begin(count, t + 1, n);
+				ForwardIt it = std::next(first, i);
+				for(; i < end; ++i, ++it)
+				{
+					hashNode* node = __construct_node(*it);
+					size_type hash;
+					try
+					{
+						hash = __hash(node->value.first);
+					}
+					catch(...)
+					{
+						__free_node(node);
+						throw;
+					}
+					node->store_hash(hash);
+					lists[t * n + __index(hash) / span].push(node);
+				}
+			});
+		}
+		catch(...)
+		{
+			__free_lists(lists);
+			throw;
+		}
+
+		// link them; a list's head is always its first node not yet linked,
+		// so whatever a failure leaves behind can be freed
+		std::vector<size_type> linked(n), dropped(n);
+		std::exception_ptr error;
+		try
+		{
+			__run_threads(n, [&](unsigned t)
+			{
+				for(unsigned s = 0; s < n; ++s)
+					for(hashNode*& node = lists[s * n + t].head; node; )
+					{
+						size_type hash = __node_hash(node);
+						hashNode*& head = __buckets[__index(hash)];
+						bool present = false;
+						for(hashNode* m = head; m && !present; m = m->next)
+							present = m->hash_may_equal(hash) && __equal(m->value.first, node->value.first);
+						hashNode* next = node->next;
+						if(present)
+						{
+							__free_node(node);
+							++dropped[t];
+						}
+						else
+						{
+							node->next = head;
+							head = node;
+							++linked[t];
+						}
+						node = next;
+					}
+			});
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+		size_type freed = __free_lists(lists);
+		for(unsigned t = 0; t < n; ++t)
+		{
+			__size += linked[t];
+			freed += dropped[t];
+		}
+		__stats.node_allocated(count);
+		__stats.node_deallocated(freed);
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	// LOOKUP
+	// K is key_type or, for transparent Hash and KeyEqual, anything they accept
+	template<class K>
+	position find(const K& key) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, __hash(key));
+	}
+
+	// lookups split in two, for batches: hash every key, prefetch, then find
+	template<class K>
+	size_type hash_key(const K& key) const { return __hash(key); }
+	// pull in the bucket head a lookup of hash would read
+	void prefetch(size_type hash) const
+	{
+		if(__bucket_count != 0)
+			__builtin_prefetch(__buckets + __index(hash));
+	}
+	template<class K>
+	position find_hashed(const K& key, size_type hash) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, hash);
+	}
+
+	// MODIFIERS
+	template<class K, class... Args>
+	pair<position, bool> try_emplace(K&& key, Args&&... args)
+	{
+		size_type hash = __hash(key);
+		return __try_emplace(hash, ::forward<K>(key), ::forward<Args>(args)...);
+	}
+
+	// try_emplace for a key whose hash_key() is already known
+	template<class K, class... Args>
+	pair<position, bool> try_emplace_hashed(size_type hash, K&& key, Args&&... args)
+	{
+		if(RESEED && __reseed_size)
+			hash = __hash(key);
+		return __try_emplace(hash, ::forward<K>(key), ::forward<Args>(args)...);
+	}
+
+	template<class... Args>
+	pair<position, bool> emplace(Args&&... args)
+	{
+		hashNode* n = __create_node(::forward<Args>(args)...);
+		size_type hash;
+		position p;
+		try
+		{
+			hash = __hash(n->value.first);
+			p = __find(n->value.first, hash);
+		}
+		catch(...)
+		{
+			__destroy_node(n);
+			throw;
+		}
+		if(p != last())
+		{
+			__destroy_node(n);
+			return pair<position, bool>(p, false);
+		}
+		return pair<position, bool>(__link(n, hash), true);
+	}
+
+	position erase(position p)
+	{
+		position next = p;
+		advance(next);
+		hashNode** link = &__head(p.bucket);
+		while(*link != p.node)
+			link = &(*link)->next;
+		*link = p.node->next;
+		__destroy_node(p.node);
+		--__size;
+		__floor.erased(__size, __bucket_count, __desired_load_factor);
+		return next;
+	}
+
+	position erase_range(position first, position last)
+	{
+		while(first != last)
+			first = erase(first);
+		return first;
+	}
+
+	template<class K>
+	size_type erase_key(const K& key)
+	{
+		position p = find(key);
+		if(p == last())
+			return 0;
+		erase(p);
+		return 1;
+	}
+
+	// unlink the node at p and hand it to the caller, who frees it with
+	// the allocator; the stats count it as gone
+	node* extract(position p)
+	{
+		if(Policy::NODE_POOL)
+		{
+			node* n = __make_node<node>(__node_alloc, p.node->value.first,
+				std::move(p.node->value.second));
+			n->copy_hash(*p.node);
+			erase(p);
+			return n;
+		}
+		hashNode** link = &__head(p.bucket);
+		while(*link != p.node)
+			link = &(*link)->next;
+		*link = p.node->next;
+		--__size;
+		__floor.erased(__size, __bucket_count, __desired_load_factor);
+		__stats.node_deallocated();
+		return p.node;
+	}
+
+	// link n unless its key is already present, in which case it stays
+	// with the caller; hash_valid says whether its cached hash still
+	// matches its key
+	pair<position, bool> insert_node(node* n, bool hash_valid)
+	{
+		size_type hash = hash_valid ? __foreign_hash(n) : __hash(n->value.first);
+		position p = __find(n->value.first, hash);
+		if(p != last())
+			return pair<position, bool>(p, false);
+		if(Policy::NODE_POOL)
+		{
+			hashNode* copy = __create_node(n->value.first,
+				std::move(n->value.second));
+			__drop_node(__node_alloc, n);
+			return pair<position, bool>(__link(copy, hash), true);
+		}
+		__grow(__size + 1);
+		__stats.node_allocated();
+		return pair<position, bool>(__push(n, hash), true);
+	}
+
+	// move across every node of source whose key is not present here
+	void merge(chainedStorage& source)
+	{
+		if(Policy::NODE_POOL || !(__node_alloc == source.__node_alloc))
+		{
+			__merge_values(*this, source);
+			return;
+		}
+		if(this == &source)
+			return;
+		for(size_type b = 0; b < source.__old_count + source.__bucket_count; ++b)
+			for(hashNode** link = &source.__head(b); *link; )
+			{
+				hashNode* n = *link;
+				size_type hash = __foreign_hash(n);
+				if(__find(n->value.first, hash) != last())
+				{
+					link = &n->next;
+					continue;
+				}
+				__grow(__size + 1);
+				*link = n->next;
+				--source.__size;
+				__push(n, hash);
+				__stats.node_allocated();
+				source.__stats.node_deallocated();
+			}
+	}
+
+	void clear() noexcept
+	{
+		for(size_type i = 0; i < __old_count + __bucket_count; ++i)
+		{
+			hashNode*& head = __head(i);
+			hashNode* n = head;
+			while(n)
+			{
+				hashNode* next = n->next;
+				if(Policy::NODE_POOL)
+				{
+					node_traits::destroy(__node_alloc, n);
+					__stats.node_deallocated();
+				}
+				else
+					__destroy_node(n);
+				n = next;
+			}
+			head = nullptr;
+		}
+		if(Policy::NODE_POOL)
+			__pool.release(__node_alloc);
+		__size = 0;
+		__migrate(__old_count);
+		// with a minimum load factor the buckets go too, and the next
+		// insert allocates a small array
+		if(__floor.min_load_factor > 0)
+			__deallocate_buckets();
+	}
+
+private:
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<hashNode> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<hashNode*> bucket_allocator;
+	typedef std::allocator_traits<bucket_allocator> bucket_traits;
+	typedef typename Policy::bucket_index index_type;
+	typedef statsRecorder<Policy::STATS != 0> stats_type;
+
+
+
+	// bucket head by position index, old array first
+	hashNode*& __head(size_type b) const
+		{ return b < __old_count ? __old_buckets[b] : __buckets[b - __old_count]; }
+
+	void __skip_empty(position& p) const
+	{
+		size_type total = __old_count + __bucket_count;
+		while(p.bucket < total && !__head(p.bucket))
+			++p.bucket;
+		p.node = p.bucket < total ? __head(p.bucket) : nullptr;
+	}
+
+	// move up to steps old buckets into the new array, and drop the old
+	// array once it is empty
+	void __migrate(size_type steps)
+	{
+		if(!__old_buckets)
+			return;
+		for(; steps && __migrated < __old_count; --steps, ++__migrated)
+		{
+			hashNode* n = __old_buckets[__migrated];
+			while(n)
+			{
+				hashNode* next = n->next;
+				hashNode*& head = __buckets[__index(__node_hash(n))];
+				n->next = head;
+				head = n;
+				n = next;
+			}
+			__old_buckets[__migrated] = nullptr;
+		}
+		if(__migrated == __old_count)
+		{
+			bucket_traits::deallocate(__bucket_alloc, __old_buckets, __old_count);
+			__old_buckets = nullptr;
+			__old_count = 0;
+			__migrated = 0;
+		}
+	}
+
+	void __allocate_buckets(size_type count)
+	{
+		if(count == 0)
+			return;
+		__buckets = bucket_traits::allocate(__bucket_alloc, count);
+		for(size_type i = 0; i < count; ++i)
+			__buckets[i] = nullptr;
+		__bucket_count = count;
+		__index.reset(count);
+		__stats.array_allocated();
+	}
+
+	void __deallocate_buckets()
+	{
+		if(__buckets)
+			bucket_traits::deallocate(__bucket_alloc, __buckets, __bucket_count);
+		__buckets = nullptr;
+		__bucket_count = 0;
+	}
+
+	template<class... Args>
+	hashNode* __create_node(Args&&... args)
+	{
+		hashNode* n = __construct_node(::forward<Args>(args)...);
+		__stats.node_allocated();
+		return n;
+	}
+
+	// __create_node and __destroy_node without the stats, for parallel builds
+	template<class... Args>
+	hashNode* __construct_node(Args&&... args)
+	{
+		hashNode* n = Policy::NODE_POOL ? __pool.allocate(__node_alloc) : node_traits::allocate(__node_alloc, 1);
+		try
+		{
+			node_traits::construct(__node_alloc, n, ::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			__deallocate_node(n);
+			throw;
+		}
+		return n;
+	}
+
+	void __free_node(hashNode* n)
+	{
+		node_traits::destroy(__node_alloc, n);
+		__deallocate_node(n);
+	}
+
+	void __deallocate_node(hashNode* n)
+	{
+		if(Policy::NODE_POOL)
+			__pool.deallocate(n);
+		else
+			node_traits::deallocate(__node_alloc, n, 1);
+	}
+
+	void __destroy_node(hashNode* n)
+	{
+		__free_node(n);
+		__stats.node_deallocated();
+	}
+
+	// nodes sorted by a parallel rehash or build, in the order pushed
+	struct __nodeList
+	{
+		__nodeList() : head(nullptr), tail(nullptr) {}
+
+		void push(hashNode* n)
+		{
+			n->next = nullptr;
+			if(tail)
+				tail->next = n;
+			else
+				head = n;
+			tail = n;
+		}
+
+		hashNode* head;
+		hashNode* tail;
+	};
+
+	// free the nodes still on the lists and return how many there were
+	size_type __free_lists(std::vector<__nodeList>& lists)
+	{
+		size_type freed = 0;
+		for(std::size_t i = 0; i < lists.size(); ++i)
+			for(hashNode* n = lists[i].head; n; ++freed)
+			{
+				hashNode* next = n->next;
+				__free_node(n);
+				n = next;
+			}
+		return freed;
+	}
+
+	template<class K, class... Args>
+	pair<position, bool> __try_emplace(size_type hash, K&& key, Args&&... args)
+	{
+		position p = __find(key, hash);
+		if(p != last())
+			return pair<position, bool>(p, false);
+		hashNode* n = __create_node(std::piecewise_construct,
+			std::forward_as_tuple(::forward<K>(key)), std::forward_as_tuple(::forward<Args>(args)...));
+		return pair<position, bool>(__link(n, hash), true);
+	}
+
+	size_type __node_hash(const hashNode* n) const { return n->load_hash(__hash, n->value.first); }
+
+	// the hash of a node from another table, whose cache is only trusted
+	// when no Hash object can hash differently from this one
+	size_type __foreign_hash(const hashNode* n) const
+	{ return std::is_empty<hasher>::value ? __node_hash(n) : __hash(n->value.first); }
+
+	template<class K>
+	position __find(const K& key, size_type hash) const
+	{
+		size_type probes = 0;
+		if(__old_buckets)
+		{
+			size_type b = __old_index(hash);
+			if(b >= __migrated)
+				for(hashNode* n = __old_buckets[b]; n; n = n->next, ++probes)
+					if(n->hash_may_equal(hash) && __equal(n->value.first, key))
+					{
+						__stats.probe(probes + 1);
+						return position{ n, b };
+					}
+		}
+		if(__bucket_count != 0)
+		{
+			size_type b = __index(hash);
+			for(hashNode* n = __buckets[b]; n; n = n->next, ++probes)
+				if(n->hash_may_equal(hash) && __equal(n->value.first, key))
+				{
+					__stats.probe(probes + 1);
+					return position{ n, __old_count + b };
+				}
+		}
+		__stats.probe(probes);
+		return last();
+	}
+
+	// grow if one more element would exceed the load factor, then push n
+	// onto the front of its bucket
+	position __link(hashNode* n, size_type hash)
+	{
+		try
+		{
+			__grow(__size + 1);
+		}
+		catch(...)
+		{
+			__destroy_node(n);
+			throw;
+		}
+		return __push(n, hash);
+	}
+
+	// rehash if size elements would exceed the load factor, or shrink if
+	// erases left the table below its minimum load factor; either way an
+	// incremental table only starts a migration here
+	void __grow(size_type size)
+	{
+		if(__floor.due(__size, __bucket_count, __desired_load_factor))
+			rehash(__loadFloor::target(size, __desired_load_factor));
+		else if(size > __bucket_count * __desired_load_factor)
+			rehash(__bucket_count * 2 > size ? __bucket_count * 2 : size);
+	}
+
+	// push n onto the front of its bucket, the table already big enough
+	position __push(hashNode* n, size_type hash)
+	{
+		// after a shrink the old array is the larger and mostly empty, so
+		// each insert sweeps proportionally more of it, and the migration
+		// ends after as many inserts as one that grew would
+		size_type ratio = __old_count > __bucket_count ? __old_count / __bucket_count : 1;
+		__migrate(Policy::REHASH_STEP * ratio);
+		n->store_hash(hash);
+		size_type b = __index(hash);
+		n->next = __buckets[b];
+		__buckets[b] = n;
+		++__size;
+		if(Policy::STATS || RESEED)
+		{
+			size_type length = 0;
+			for(hashNode* m = n; m; m = m->next)
+				++length;
+			__stats.chain(length, Policy::CHAIN_WARNING);
+			if(RESEED && length > size_type(Policy::RESEED_CHAIN) && __size >= 2 * __reseed_size)
+			{
+				__reseed();
+				return position{ n, __index(__node_hash(n)) };
+			}
+		}
+		return position{ n, __old_count + b };
+	}
+
+	// draw a new seed and relink every node under it, finishing any
+	// incremental migration; the bucket array is reused
+	void __reseed()
+	{
+		__reseed_size = __size;
+		typename stats_type::time_point start = __stats.rehash_begin();
+		__reseed_hash(__hash);
+		hashNode* all = nullptr;
+		for(size_type b = 0; b < __old_count + __bucket_count; ++b)
+		{
+			for(hashNode* n = __head(b); n; )
+			{
+				hashNode* next = n->next;
+				n->next = all;
+				all = n;
+				n = next;
+			}
+			__head(b) = nullptr;
+		}
+		if(__old_buckets)
+			bucket_traits::deallocate(__bucket_alloc, __old_buckets, __old_count);
+		__old_buckets = nullptr;
+		__old_count = 0;
+		__migrated = 0;
+		while(all)
+		{
+			hashNode* next = all->next;
+			size_type hash = __hash(all->value.first);
+			all->store_hash(hash);
+			hashNode*& head = __buckets[__index(hash)];
+			all->next = head;
+			head = all;
+			all = next;
+		}
+		__stats.reseeded();
+		__stats.rehash_end(start);
+	}
+
+	// only instantiated for a Hash that has reseed()
+	template<class H>
+	static void __reseed_hash(H& hash, typename std::enable_if<__is_reseedable<H>::value>::type* = nullptr) { hash.reseed(); }
+	template<class H>
+	static void __reseed_hash(H&, typename std::enable_if<!__is_reseedable<H>::value>::type* = nullptr) {}
+
+	hasher __hash;
+	key_equal __equal;
+	node_allocator __node_alloc;
+	bucket_allocator __bucket_alloc;
+	nodePool<hashNode, node_allocator, Policy::POOL_MAX_SLAB> __pool;	// unused unless Policy::NODE_POOL
+	hashNode** __buckets;
+	size_type __bucket_count;
+	hashNode** __old_buckets;	// non-null while an incremental rehash is under way
+	size_type __old_count;
+	size_type __migrated;		// old buckets already moved
+	index_type __index;			// maps hashes to buckets of the current array
+	index_type __old_index;
+	size_type __size;
+	float __desired_load_factor;
+	__loadFloor __floor;		// minimum load factor
+	size_type __reseed_size;	// size at the last reseed, 0 if there was none
+	stats_type __stats;
+};
+
+#endif // __CHAINED_STORAGE_H__
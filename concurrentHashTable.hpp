@@ -0,0 +1,634 @@
+#ifndef __CONCURRENT_HASH_TABLE_H__
+#define __CONCURRENT_HASH_TABLE_H__
+
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "epochDomain.hpp"
+
+// A chained hash table that many threads may use at once.
+//
+// Readers never lock: they walk the bucket chains under an epochGuard and
+// only ever see fully built nodes. Writers take the lock of the stripe the
+// key hashes to, so writers on different stripes run in parallel. Nodes
+// are never modified once published; insert_or_assign swaps in a new node
+// and erased or replaced nodes are handed to the epoch domain, which frees
+// them once no reader can still hold them.
+//
+// Each stripe owns the bucket array its keys hash to and grows it under
+// its own lock alone, publishing a new array of copied nodes, so readers
+// still walking the old array stay on a consistent snapshot and writers
+// on other stripes carry on. Because elements can be replaced at any time
+// there are no iterators; lookups copy the mapped value out or run a
+// visitor on it.
+template<class Key,
+	class T = Key,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >
+> class concurrent_hashTable
+{
+public:
+	enum { DEFAULT_BUCKET_SIZE = 64 };
+
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	explicit concurrent_hashTable(size_type bucket_count = DEFAULT_BUCKET_SIZE,
+		const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(),
+		const Allocator& alloc = Allocator());
+
+	concurrent_hashTable(const concurrent_hashTable&) = delete;
+	concurrent_hashTable& operator=(const concurrent_hashTable&) = delete;
+
+	~concurrent_hashTable();
+
+	// LOOKUP
+	bool find(const key_type& key, mapped_type& out) const;
+	template<class F>
+	bool visit(const key_type& key, F f) const;
+	size_type count(const key_type& key) const;
+	bool contains(const key_type& key) const;
+
+	// MODIFIERS
+	// each returns true if the key was not present before
+	template<class M>
+	bool insert_or_assign(const key_type& k, M&& obj);
+	template<class... Args>
+	bool try_emplace(const key_type& k, Args&&... args);
+	size_type erase(const key_type& key);
+	void clear();
+
+	// CAPACITY
+	size_type size() const noexcept;
+	bool empty() const noexcept;
+
+	// HASH POLICY
+	size_type bucket_count() const;
+	float load_factor() const;
+	float max_load_factor() const;
+	void max_load_factor(float ml);
+	void reserve(size_type count);
+
+private:
+	struct node
+	{
+		template<class... Args>
+		node(size_type h, Args&&... args)
+			: value(::forward<Args>(args)...), hash(h), next(nullptr) {}
+
+		value_type value;
+		size_type hash;
+		std::atomic<node*> next;
+	};
+
+	struct bucketArray
+	{
+		size_type count;
+		std::atomic<node*>* heads;
+	};
+
+	struct stripe
+	{
+		stripe() : table(nullptr), count(0) {}
+
+		std::mutex lock;
+		std::atomic<bucketArray*> table;	// the buckets of this stripe's keys
+		std::atomic<size_type> count;		// elements in table
+		char pad[64];
+	};
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+
+	// the top bits pick the stripe and the low bits the bucket within it
+	stripe& __stripe_of(size_type hash) const { return __stripes[hash >> __stripe_shift]; }
+
+	const node* __find(const key_type& key, size_type hash) const;
+	void __grow(stripe& s, size_type count);
+	void __lock_all();
+	void __unlock_all();
+
+	template<class... Args>
+	node* __create_node(size_type hash, Args&&... args);
+	void __destroy_node(node* n);
+	bucketArray* __create_array(size_type count);
+	void __retire(node* n);
+	void __retire(bucketArray* a);
+
+	static void __free_node(void* owner, void* ptr);
+	static void __free_array(void* owner, void* ptr);
+
+	hasher __hash;
+	key_equal __equal;
+	mutable node_allocator __node_alloc;
+	std::atomic<size_type> __bucket_count;	// over all stripes, readable without a guard
+	stripe* __stripes;
+	size_type __stripe_count;
+	size_type __stripe_shift;
+	std::atomic<float> __desired_load_factor;
+};
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::concurrent_hashTable(
+		size_type bucket_count,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __hash(hash), __equal(equal), __node_alloc(alloc), __bucket_count(0),
+	  __stripes(nullptr), __stripe_count(0), __stripe_shift(0), __desired_load_factor(1.0f)
+{
+	// make sure the domain outlives this table even if it is static
+	epochDomain::global();
+
+	size_type threads = std::thread::hardware_concurrency();
+	__stripe_count = __next_pow2(threads ? 4 * threads : 16);
+	if(__stripe_count < 16)
+		__stripe_count = 16;
+	__stripe_shift = sizeof(size_type) * 8;
+	for(size_type n = __stripe_count; n > 1; n >>= 1)
+		--__stripe_shift;
+	__stripes = new stripe[__stripe_count];
+	size_type per_stripe = __next_pow2(bucket_count / __stripe_count ? bucket_count / __stripe_count : 1);
+	try
+	{
+		for(size_type i = 0; i < __stripe_count; ++i)
+			__stripes[i].table.store(__create_array(per_stripe), std::memory_order_relaxed);
+	}
+	catch(...)
+	{
+		for(size_type i = 0; i < __stripe_count; ++i)
+			if(bucketArray* a = __stripes[i].table.load(std::memory_order_relaxed))
+				__free_array(this, a);
+		delete[] __stripes;
+		throw;
+	}
+	__bucket_count.store(per_stripe * __stripe_count);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::~concurrent_hashTable()
+{
+	for(size_type i = 0; i < __stripe_count; ++i)
+		__free_array(this, __stripes[i].table.load());
+	epochDomain::global().drain(this);
+	delete[] __stripes;
+}
+
+// LOOKUP
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+const typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::node* concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__find(const key_type& key, size_type hash) const
+{
+	const bucketArray* a = __stripe_of(hash).table.load(std::memory_order_acquire);
+	for(const node* n = a->heads[hash & (a->count - 1)].load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire))
+		if(n->hash == hash && __equal(n->value.first, key))
+			return n;
+	return nullptr;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::find(const key_type& key, mapped_type& out) const
+{
+	return visit(key, [&out](const value_type& value) { out = value.second; });
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class F>
+bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::visit(const key_type& key, F f) const
+{
+	size_type hash = __mix_hash(__hash(key));
+	epochGuard guard;
+	const node* n = __find(key, hash);
+	if(!n)
+		return false;
+	f(n->value);
+	return true;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::count(const key_type& key) const
+{ return contains(key) ? 1 : 0; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::contains(const key_type& key) const
+{
+	size_type hash = __mix_hash(__hash(key));
+	epochGuard guard;
+	return __find(key, hash) != nullptr;
+}
+
+// MODIFIERS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class M>
+bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::insert_or_assign(const key_type& k, M&& obj)
+{
+	size_type hash = __mix_hash(__hash(k));
+	stripe& s = __stripe_of(hash);
+	bool inserted;
+	{
+		std::lock_guard<std::mutex> lock(s.lock);
+		bucketArray* a = s.table.load(std::memory_order_relaxed);
+		std::atomic<node*>* link = a->heads + (hash & (a->count - 1));
+		node* n = link->load(std::memory_order_relaxed);
+		while(n && !(n->hash == hash && __equal(n->value.first, k)))
+		{
+			link = &n->next;
+			n = link->load(std::memory_order_relaxed);
+		}
+		// nodes are immutable once published, so replace rather than assign
+		node* replacement = __create_node(hash, k, ::forward<M>(obj));
+		if(n)
+		{
+			replacement->next.store(n->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			link->store(replacement, std::memory_order_release);
+			__retire(n);
+			inserted = false;
+		}
+		else
+		{
+			std::atomic<node*>& head = a->heads[hash & (a->count - 1)];
+			replacement->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			head.store(replacement, std::memory_order_release);
+			s.count.fetch_add(1, std::memory_order_relaxed);
+			__grow(s, 0);
+			inserted = true;
+		}
+	}
+	return inserted;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class... Args>
+bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::try_emplace(const key_type& k, Args&&... args)
+{
+	size_type hash = __mix_hash(__hash(k));
+	stripe& s = __stripe_of(hash);
+	{
+		std::lock_guard<std::mutex> lock(s.lock);
+		bucketArray* a = s.table.load(std::memory_order_relaxed);
+		std::atomic<node*>& head = a->heads[hash & (a->count - 1)];
+		for(node* n = head.load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed))
+			if(n->hash == hash && __equal(n->value.first, k))
+				return false;
+		node* n = __create_node(hash, std::piecewise_construct,
+			std::forward_as_tuple(k), std::forward_as_tuple(::forward<Args>(args)...));
+		n->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		head.store(n, std::memory_order_release);
+		s.count.fetch_add(1, std::memory_order_relaxed);
+		__grow(s, 0);
+	}
+	return true;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::erase(const key_type& key)
+{
+	size_type hash = __mix_hash(__hash(key));
+	stripe& s = __stripe_of(hash);
+	std::lock_guard<std::mutex> lock(s.lock);
+	bucketArray* a = s.table.load(std::memory_order_relaxed);
+	std::atomic<node*>* link = a->heads + (hash & (a->count - 1));
+	for(node* n = link->load(std::memory_order_relaxed); n; n = link->load(std::memory_order_relaxed))
+	{
+		if(n->hash == hash && __equal(n->value.first, key))
+		{
+			// readers standing on n still find its next pointer intact
+			link->store(n->next.load(std::memory_order_relaxed), std::memory_order_release);
+			s.count.fetch_sub(1, std::memory_order_relaxed);
+			__retire(n);
+			return 1;
+		}
+		link = &n->next;
+	}
+	return 0;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::clear()
+{
+	// every stripe is emptied under its lock at once, into an array of the
+	// size it has, so that clear() is all or nothing
+	__lock_all();
+	std::vector<bucketArray*> fresh;
+	try
+	{
+		fresh.reserve(__stripe_count);
+		for(size_type i = 0; i < __stripe_count; ++i)
+			fresh.push_back(__create_array(__stripes[i].table.load(std::memory_order_relaxed)->count));
+	}
+	catch(...)
+	{
+		for(std::size_t i = 0; i < fresh.size(); ++i)
+			__free_array(this, fresh[i]);
+		__unlock_all();
+		throw;
+	}
+	for(size_type i = 0; i < __stripe_count; ++i)
+	{
+		fresh[i] = __stripes[i].table.exchange(fresh[i], std::memory_order_release);
+		__stripes[i].count.store(0, std::memory_order_relaxed);
+	}
+	__unlock_all();
+	for(size_type i = 0; i < __stripe_count; ++i)
+		__retire(fresh[i]);
+}
+
+// CAPACITY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::size() const noexcept
+{
+	size_type total = 0;
+	for(size_type i = 0; i < __stripe_count; ++i)
+		total += __stripes[i].count.load(std::memory_order_relaxed);
+	return total;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline bool concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::empty() const noexcept
+{ return size() == 0; }
+
+// HASH POLICY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::bucket_count() const
+{ return __bucket_count.load(std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline float concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::load_factor() const
+{ return float(size()) / bucket_count(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline float concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::max_load_factor() const
+{ return __desired_load_factor.load(std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::max_load_factor(float ml)
+{ __desired_load_factor.store(ml, std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::reserve(size_type count)
+{
+	// hashes spread evenly over the stripes
+	size_type per_stripe = static_cast<size_type>(std::ceil(count / max_load_factor() / __stripe_count));
+	for(size_type i = 0; i < __stripe_count; ++i)
+	{
+		std::lock_guard<std::mutex> lock(__stripes[i].lock);
+		__grow(__stripes[i], per_stripe);
+	}
+}
+
+// INTERNALS
+// grow the buckets of s, whose lock is held, to at least count, or by
+// doubling if its load factor is exceeded; a no-op when neither applies.
+// Only the keys of s are copied, and only its writers wait.
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__grow(stripe& s, size_type count)
+{
+	float ml = max_load_factor();
+	bucketArray* old = s.table.load(std::memory_order_relaxed);
+	size_type size = s.count.load(std::memory_order_relaxed);
+	size_type target = old->count;
+	while(target < count || size > target * ml)
+		target *= 2;
+	if(target == old->count)
+		return;
+
+	bucketArray* fresh = nullptr;
+	try
+	{
+		fresh = __create_array(target);
+		for(size_type i = 0; i < old->count; ++i)
+			for(node* n = old->heads[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed))
+			{
+				// readers may still be walking the old chains, so copy rather than relink
+				node* copy = __create_node(n->hash, n->value);
+				std::atomic<node*>& head = fresh->heads[n->hash & (target - 1)];
+				copy->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				head.store(copy, std::memory_order_relaxed);
+			}
+	}
+	catch(...)
+	{
+		// growing is an optimisation; leave the table as it was
+		if(fresh)
+			__free_array(this, fresh);
+		return;
+	}
+	s.table.store(fresh, std::memory_order_release);
+	__bucket_count.fetch_add(target - old->count, std::memory_order_relaxed);
+	__retire(old);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__lock_all()
+{
+	for(size_type i = 0; i < __stripe_count; ++i)
+		__stripes[i].lock.lock();
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__unlock_all()
+{
+	for(size_type i = __stripe_count; i > 0; --i)
+		__stripes[i - 1].lock.unlock();
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class... Args>
+typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::node* concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__create_node(size_type hash, Args&&... args)
+{
+	node* n = node_traits::allocate(__node_alloc, 1);
+	try
+	{
+		node_traits::construct(__node_alloc, n, hash, ::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		node_traits::deallocate(__node_alloc, n, 1);
+		throw;
+	}
+	return n;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__destroy_node(node* n)
+{
+	node_traits::destroy(__node_alloc, n);
+	node_traits::deallocate(__node_alloc, n, 1);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::bucketArray* concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__create_array(size_type count)
+{
+	bucketArray* a = new bucketArray;
+	a->count = count;
+	try
+	{
+		a->heads = new std::atomic<node*>[count];
+	}
+	catch(...)
+	{
+		delete a;
+		throw;
+	}
+	for(size_type i = 0; i < count; ++i)
+		a->heads[i].store(nullptr, std::memory_order_relaxed);
+	return a;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__retire(node* n)
+{ epochDomain::global().retire(this, n, &__free_node); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__retire(bucketArray* a)
+{ epochDomain::global().retire(this, a, &__free_array); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__free_node(void* owner, void* ptr)
+{ static_cast<concurrent_hashTable*>(owner)->__destroy_node(static_cast<node*>(ptr)); }
+
+// frees a bucket array together with every node still chained in it
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void concurrent_hashTable<Key, T, Hash, KeyEqual, Allocator>::__free_array(void* owner, void* ptr)
+{
+	concurrent_hashTable* table = static_cast<concurrent_hashTable*>(owner);
+	bucketArray* a = static_cast<bucketArray*>(ptr);
+	for(size_type i = 0; i < a->count; ++i)
+	{
+		node* n = a->heads[i].load(std::memory_order_relaxed);
+		while(n)
+		{
+			node* next = n->next.load(std::memory_order_relaxed);
+			table->__destroy_node(n);
+			n = next;
+		}
+	}
+	delete[] a->heads;
+	delete a;
+}
+
+#endif // __CONCURRENT_HASH_TABLE_H__
@@ -0,0 +1,109 @@
+#ifndef __CONTROL_GROUP_H__
+#define __CONTROL_GROUP_H__
+
+#include <cstdint>
+#include <cstring>
+
+#if !defined(HASHTABLE_SCALAR_GROUP) && defined(__AVX2__)
+#include <immintrin.h>
+#elif !defined(HASHTABLE_SCALAR_GROUP) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// CONTROL BYTES
+// One byte per slot. A full slot stores the low 7 bits of its hash (H2),
+// so the sign bit alone tells full slots from special ones.
+typedef signed char ctrl_t;
+
+enum : ctrl_t
+{
+	CTRL_EMPTY = -128,	// 0b10000000
+	CTRL_DELETED = -2	// 0b11111110
+};
+
+inline bool __ctrl_full(ctrl_t c) { return c >= 0; }
+
+inline unsigned __lowest_bit(std::uint64_t mask)
+{ return static_cast<unsigned>(__builtin_ctzll(mask)); }
+
+// GROUPS
+// A group scans a run of control bytes at once and returns a bitmask of
+// matching slots. index(mask) turns the lowest set bit into a slot offset.
+#if !defined(HASHTABLE_SCALAR_GROUP) && defined(__AVX2__)
+
+struct ctrlGroup
+{
+	enum { WIDTH = 32 };
+	typedef std::uint32_t mask_type;
+
+	explicit ctrlGroup(const ctrl_t* ctrl)
+		: ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl))) {}
+
+	mask_type match(ctrl_t h2) const
+	{ return static_cast<mask_type>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(h2)))); }
+	mask_type match_empty() const
+	{ return static_cast<mask_type>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(CTRL_EMPTY)))); }
+	mask_type match_empty_or_deleted() const
+	{ return static_cast<mask_type>(_mm256_movemask_epi8(ctrl)); }
+
+	static unsigned index(mask_type mask) { return __lowest_bit(mask); }
+
+	__m256i ctrl;
+};
+
+#elif !defined(HASHTABLE_SCALAR_GROUP) && defined(__SSE2__)
+
+struct ctrlGroup
+{
+	enum { WIDTH = 16 };
+	typedef std::uint32_t mask_type;
+
+	explicit ctrlGroup(const ctrl_t* ctrl)
+		: ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+	mask_type match(ctrl_t h2) const
+	{ return static_cast<mask_type>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)))); }
+	mask_type match_empty() const
+	{ return static_cast<mask_type>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(CTRL_EMPTY)))); }
+	mask_type match_empty_or_deleted() const
+	{ return static_cast<mask_type>(_mm_movemask_epi8(ctrl)); }
+
+	static unsigned index(mask_type mask) { return __lowest_bit(mask); }
+
+	__m128i ctrl;
+};
+
+#else
+
+// portable fallback: eight control bytes in a 64 bit word, matched with
+// the usual has-zero-byte trick. match() may report a false positive next
+// to a real match, which only costs one extra key comparison.
+struct ctrlGroup
+{
+	enum { WIDTH = 8 };
+	typedef std::uint64_t mask_type;
+
+	explicit ctrlGroup(const ctrl_t* ctrl)
+		{ std::memcpy(&word, ctrl, sizeof(word)); }
+
+	mask_type match(ctrl_t h2) const
+	{
+		std::uint64_t x = word ^ (LSBS * static_cast<unsigned char>(h2));
+		return (x - LSBS) & ~x & MSBS;
+	}
+	mask_type match_empty() const
+	{ return word & ~(word << 6) & MSBS; }
+	mask_type match_empty_or_deleted() const
+	{ return word & MSBS; }
+
+	static unsigned index(mask_type mask) { return __lowest_bit(mask) >> 3; }
+
+	static const std::uint64_t LSBS = 0x0101010101010101ULL;
+	static const std::uint64_t MSBS = 0x8080808080808080ULL;
+
+	std::uint64_t word;
+};
+
+#endif
+
+#endif // __CONTROL_GROUP_H__
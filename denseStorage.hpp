@@ -0,0 +1,593 @@
+#ifndef __DENSE_STORAGE_H__
+#define __DENSE_STORAGE_H__
+
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "nodeHandle.hpp"
+#include "parallel.hpp"
+#include "tableStats.hpp"
+
+// Dense storage: every value_type sits in one contiguous array, in
+// insertion order until something is erased, and a separate open
+// addressing index maps hashes to positions in that array. Iteration is a
+// linear scan of the values alone, and clearing or destroying the table
+// never walks the index.
+//
+// Erase moves the last value into the hole (swap and pop), so it
+// invalidates iterators to the erased and the last element and reorders
+// the ones after it. The index uses linear probing with backward shift
+// deletion, so it never holds tombstones. Each index slot keeps the high 32
+// bits of the mixed hash next to a 32 bit position, which lets probes and
+// rehashes skip the values entirely and limits the table to 2^32 - 1
+// elements.
+//
+// With Policy::STATS a chain is the number of index slots a probe visits.
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class denseStorage
+{
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	// an index into the value array, END past the last one so that end()
+	// survives inserts and erases; local positions are index slots
+	typedef size_type position;
+	typedef size_type local_position;
+	typedef __valueNode<value_type> node;
+
+	enum { DEFAULT_MAX_LOAD_FACTOR_PERCENT = 750, MAX_LOAD_FACTOR_PERCENT = 950 };
+	static const size_type END = size_type(-1);
+
+	denseStorage(size_type bucket_count, const hasher& hash,
+		const key_equal& equal, const allocator_type& alloc)
+		: __hash(hash), __equal(equal), __value_alloc(alloc), __slot_alloc(alloc),
+		  __values(nullptr), __slots(nullptr), __size(0), __value_capacity(0), __capacity(0),
+		  __desired_load_factor(DEFAULT_MAX_LOAD_FACTOR_PERCENT / 1000.0f)
+		{ __allocate_index(bucket_count ? __next_pow2(bucket_count) : 0); }
+
+	denseStorage(const denseStorage& other)
+		: denseStorage(other, value_traits::select_on_container_copy_construction(other.__value_alloc)) {}
+	denseStorage(const denseStorage& other, const allocator_type& alloc)
+		: __hash(other.__hash), __equal(other.__equal), __value_alloc(alloc), __slot_alloc(alloc),
+		  __values(nullptr), __slots(nullptr), __size(0), __value_capacity(0), __capacity(0),
+		  __desired_load_factor(other.__desired_load_factor), __floor(other.__floor.min_load_factor)
+	{
+		// values keep their positions, so the index is copied as it is
+		__allocate_index(other.__capacity);
+		try
+		{
+			__reserve_values(other.__size);
+			for(; __size < other.__size; ++__size)
+				value_traits::construct(__value_alloc, __values + __size, other.__values[__size]);
+		}
+		catch(...)
+		{
+			clear();
+			__deallocate();
+			throw;
+		}
+		for(size_type i = 0; i < __capacity; ++i)
+			__slots[i] = other.__slots[i];
+	}
+
+	denseStorage(denseStorage&& other) noexcept
+		: __hash(std::move(other.__hash)), __equal(std::move(other.__equal)),
+		  __value_alloc(std::move(other.__value_alloc)), __slot_alloc(std::move(other.__slot_alloc)),
+		  __values(other.__values), __slots(other.__slots), __size(other.__size),
+		  __value_capacity(other.__value_capacity), __capacity(other.__capacity),
+		  __desired_load_factor(other.__desired_load_factor), __floor(other.__floor), __stats(other.__stats)
+	{
+		other.__values = nullptr;
+		other.__slots = nullptr;
+		other.__size = 0;
+		other.__value_capacity = 0;
+		other.__capacity = 0;
+	}
+	denseStorage(denseStorage&& other, const allocator_type& alloc)
+		: denseStorage(0, other.__hash, other.__equal, alloc)
+	{
+		__desired_load_factor = other.__desired_load_factor;
+		__floor.min_load_factor = other.__floor.min_load_factor;
+		if(__value_alloc == other.__value_alloc)
+		{
+			swap(other);
+			return;
+		}
+		rehash(other.__capacity);
+		__reserve_values(other.__size);
+		for(position p = 0; p < other.__size; ++p)
+			__append(__mix_hash(__hash(other.__values[p].first)),
+				other.__values[p].first,
+				std::move(other.__values[p].second));
+		other.clear();
+	}
+
+	~denseStorage()
+	{
+		__destroy_values();
+		__deallocate();
+	}
+
+	void swap(denseStorage& other) noexcept
+	{
+		using std::swap;
+		swap(__hash, other.__hash);
+		swap(__equal, other.__equal);
+		if(value_traits::propagate_on_container_swap::value)
+		{
+			swap(__value_alloc, other.__value_alloc);
+			swap(__slot_alloc, other.__slot_alloc);
+		}
+		swap(__values, other.__values);
+		swap(__slots, other.__slots);
+		swap(__size, other.__size);
+		swap(__value_capacity, other.__value_capacity);
+		swap(__capacity, other.__capacity);
+		swap(__desired_load_factor, other.__desired_load_factor);
+		swap(__floor, other.__floor);
+		swap(__stats, other.__stats);
+	}
+
+	size_type size() const noexcept { return __size; }
+	size_type max_size() const noexcept
+	{
+		size_type n = value_traits::max_size(__value_alloc);
+		return n < size_type(NO_VALUE) ? n : size_type(NO_VALUE);
+	}
+	allocator_type get_allocator() const { return allocator_type(__value_alloc); }
+	hasher hash_function() const { return __hash; }
+	key_equal key_eq() const { return __equal; }
+
+	// ITERATION
+	position first() const { return __size ? 0 : END; }
+	position last() const { return END; }
+	void advance(position& p) const { p = p + 1 < __size ? p + 1 : END; }
+	value_type& value(position p) const { return __values[p]; }
+
+	// BUCKETS
+	// every index slot is a bucket holding at most one element; a missing
+	// key maps to the slot its probe starts at
+	size_type bucket_count() const { return __capacity; }
+	size_type max_bucket_count() const { return max_size(); }
+	size_type bucket(const key_type& key) const
+	{
+		if(__capacity == 0)
+			return 0;
+		std::uint32_t tag = __tag(__mix_hash(__hash(key)));
+		size_type mask = __capacity - 1;
+		for(size_type i = __home(tag);; i = (i + 1) & mask)
+			if(__slots[i].index == NO_VALUE
+				|| (__slots[i].hash == tag && __equal(__values[__slots[i].index].first, key)))
+				return __slots[i].index == NO_VALUE ? __home(tag) : i;
+	}
+	size_type bucket_size(size_type n) const { return __slots[n].index != NO_VALUE ? 1 : 0; }
+	local_position local_first(size_type n) const { return __slots[n].index != NO_VALUE ? n : n + 1; }
+	local_position local_last(size_type n) const { return n + 1; }
+	void local_advance(local_position& p) const { ++p; }
+	value_type& local_value(local_position p) const { return __values[__slots[p].index]; }
+
+	// HASH POLICY
+	// linear probing needs an empty slot to end on, so the load factor is capped
+	float max_load_factor() const { return __desired_load_factor; }
+	void max_load_factor(float ml)
+	{
+		float cap = MAX_LOAD_FACTOR_PERCENT / 1000.0f;
+		__desired_load_factor = ml < cap ? ml : cap;
+	}
+	float min_load_factor() const { return __floor.min_load_factor; }
+	void min_load_factor(float ml) { __floor.min_load_factor = ml; }
+
+	hashTableMemory memory_usage() const
+	{
+		hashTableMemory m;
+		m.add_buckets(__capacity * sizeof(__indexSlot));
+		m.add_elements(__value_capacity * sizeof(value_type));
+		return m;
+	}
+
+	hashTableStats stats() const
+	{
+		hashTableStats s;
+		s.size = __size;
+		s.bucket_count = __capacity;
+		s.load_factor = __capacity ? float(__size) / __capacity : 0.0f;
+		for(size_type i = 0; i < __capacity; ++i)
+			if(__slots[i].index != NO_VALUE)
+			{
+				size_type length = ((i - __home(__slots[i].hash)) & (__capacity - 1)) + 1;
+				++s.chain_histogram[hashTableStats::bin(length)];
+				if(length > s.max_chain)
+					s.max_chain = length;
+			}
+		__stats.fill(s);
+		return s;
+	}
+
+	void rehash(size_type count)
+	{
+		size_type capacity = __capacity_for(__size);
+		if(count > capacity)
+			capacity = __next_pow2(count);
+		if(capacity != __capacity)
+			__resize(capacity);
+		// the index never holds more values than this, so after a shrink
+		// the spare end of the value array goes back as well
+		size_type values = static_cast<size_type>(__capacity * __desired_load_factor);
+		if(values > __value_capacity || values < __value_capacity / 2)
+			__reallocate_values(values);
+	}
+
+	// probe sequences run across the whole table, so placement cannot be
+	// split by range; only the hashing runs in parallel
+	void rehash(size_type count, thread_count) { rehash(count); }
+
+	template<class ForwardIt>
+	void insert_parallel(ForwardIt first, ForwardIt last, thread_count threads)
+	{
+		size_type count = static_cast<size_type>(std::distance(first, last));
+		rehash(static_cast<size_type>(std::ceil((__size + count) / __desired_load_factor)));
+		std::vector<size_type> hashes = __hash_parallel(first, count, threads.for_size(count),
+			[this](const auto& value) { return __hash(value.first); });
+		for(size_type i = 0; i < count; ++i, ++first)
+			try_emplace_hashed(hashes[i], (*first).first, (*first).second);
+	}
+
+	// LOOKUP
+	// K is key_type or, for transparent Hash and KeyEqual, anything they accept
+	template<class K>
+	position find(const K& key) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, __mix_hash(__hash(key)));
+	}
+
+	// lookups split in two, for batches: hash every key, prefetch, then find
+	template<class K>
+	size_type hash_key(const K& key) const { return __hash(key); }
+	void prefetch(size_type hash) const
+	{
+		if(__capacity)
+			__builtin_prefetch(__slots + __home(__tag(__mix_hash(hash))));
+	}
+	template<class K>
+	position find_hashed(const K& key, size_type hash) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, __mix_hash(hash));
+	}
+
+	// MODIFIERS
+	template<class K, class... Args>
+	pair<position, bool> try_emplace(K&& key, Args&&... args)
+	{
+		size_type hash = __hash(key);
+		return try_emplace_hashed(hash, ::forward<K>(key), ::forward<Args>(args)...);
+	}
+
+	// try_emplace for a key whose hash_key() is already known
+	template<class K, class... Args>
+	pair<position, bool> try_emplace_hashed(size_type hash, K&& key, Args&&... args)
+	{
+		hash = __mix_hash(hash);
+		position p = __size ? __find(key, hash) : last();
+		if(p != last())
+			return pair<position, bool>(p, false);
+		__reserve_one();
+		return pair<position, bool>(__append(hash, std::piecewise_construct,
+			std::forward_as_tuple(::forward<K>(key)), std::forward_as_tuple(::forward<Args>(args)...)), true);
+	}
+
+	template<class... Args>
+	pair<position, bool> emplace(Args&&... args)
+	{
+		value_type tmp(::forward<Args>(args)...);
+		size_type hash = __mix_hash(__hash(tmp.first));
+		position p = __size ? __find(tmp.first, hash) : last();
+		if(p != last())
+			return pair<position, bool>(p, false);
+		__reserve_one();
+		return pair<position, bool>(__append(hash, std::move(tmp)), true);
+	}
+
+	// the last value moves into p, which is therefore also the next
+	// position to visit
+	position erase(position p)
+	{
+		size_type mask = __capacity - 1;
+		size_type hash = __mix_hash(__hash(__values[p].first));
+		size_type slot = __home(__tag(hash));
+		while(__slots[slot].index != p)
+			slot = (slot + 1) & mask;
+		__remove_slot(slot);
+
+		size_type back = __size - 1;
+		value_traits::destroy(__value_alloc, __values + p);
+		if(p != back)
+		{
+			slot = __slots_of_back();
+			__relocate_n(__value_alloc, __values + p, __values + back, 1);
+			__slots[slot].index = static_cast<std::uint32_t>(p);
+		}
+		--__size;
+		__floor.erased(__size, __capacity, __desired_load_factor);
+		return p < __size ? p : END;
+	}
+
+	// erase works back from the end of the range, so that the values
+	// moved into the holes come from beyond it
+	position erase_range(position first, position last)
+	{
+		if(first == last)
+			return last;
+		position end = last == END ? __size : last;
+		position next = end < __size ? end : END;
+		for(position p = end; p > first; --p)
+		{
+			position moved_from = __size - 1;
+			erase(p - 1);
+			if(next == moved_from)
+				next = p - 1;
+		}
+		return next;
+	}
+
+	template<class K>
+	size_type erase_key(const K& key)
+	{
+		position p = find(key);
+		if(p == last())
+			return 0;
+		erase(p);
+		return 1;
+	}
+
+	// elements leave and enter as __valueNodes, see nodeHandle.hpp
+	node* extract(position p) { return __extract_value(*this, p); }
+	pair<position, bool> insert_node(node* n, bool) { return __insert_value(*this, n); }
+	void merge(denseStorage& source) { __merge_values(*this, source); }
+
+	void clear() noexcept
+	{
+		__destroy_values();
+		// with a minimum load factor the arrays go too, and the next insert
+		// allocates small ones
+		if(__floor.min_load_factor > 0)
+			__deallocate();
+		for(size_type i = 0; i < __capacity; ++i)
+			__slots[i].index = NO_VALUE;
+	}
+
+private:
+	// eight bytes, so that the index costs little cache next to the values
+	struct __indexSlot
+	{
+		std::uint32_t hash;		// __tag of the mixed hash
+		std::uint32_t index;	// into the value array, NO_VALUE when empty
+	};
+	enum : std::uint32_t { NO_VALUE = 0xffffffff };
+
+	// The low bits of __mix_hash are its weakest, so a slot keeps the high
+	// 32 bits of the mixed hash and a value's home slot is the top bits of
+	// those, as fastrange_index does.
+	static std::uint32_t __tag(size_type hash)
+	{ return static_cast<std::uint32_t>(static_cast<std::uint64_t>(hash) >> (sizeof(size_type) * 8 - 32)); }
+	size_type __home(std::uint32_t tag) const
+	{ return static_cast<size_type>((static_cast<std::uint64_t>(tag) * __capacity) >> 32); }
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<value_type> value_allocator;
+	typedef std::allocator_traits<value_allocator> value_traits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<__indexSlot> slot_allocator;
+	typedef std::allocator_traits<slot_allocator> slot_traits;
+	typedef statsRecorder<Policy::STATS != 0> stats_type;
+
+	template<class K>
+	position __find(const K& key, size_type hash) const
+	{
+		if(__capacity == 0)
+			return last();
+		std::uint32_t tag = __tag(hash);
+		size_type mask = __capacity - 1;
+		size_type length = 1;
+		for(size_type i = __home(tag);; i = (i + 1) & mask, ++length)
+		{
+			const __indexSlot& s = __slots[i];
+			if(s.index == NO_VALUE)
+			{
+				__stats.probe(length);
+				return last();
+			}
+			if(s.hash == tag && __equal(__values[s.index].first, key))
+			{
+				__stats.probe(length);
+				return s.index;
+			}
+		}
+	}
+
+	// the index slot that points at the last value
+	size_type __slots_of_back() const
+	{
+		size_type back = __size - 1;
+		size_type mask = __capacity - 1;
+		size_type slot = __home(__tag(__mix_hash(__hash(__values[back].first))));
+		while(__slots[slot].index != back)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	// empty a slot and pull later members of its run back over it, so
+	// that every probe still reaches its element before an empty slot
+	void __remove_slot(size_type hole)
+	{
+		size_type mask = __capacity - 1;
+		for(size_type i = (hole + 1) & mask; __slots[i].index != NO_VALUE; i = (i + 1) & mask)
+		{
+			size_type home = __home(__slots[i].hash);
+			if(((i - home) & mask) >= ((i - hole) & mask))
+			{
+				__slots[hole] = __slots[i];
+				hole = i;
+			}
+		}
+		__slots[hole].index = NO_VALUE;
+	}
+
+	void __insert_slot(std::uint32_t tag, size_type index)
+	{
+		size_type mask = __capacity - 1;
+		size_type i = __home(tag);
+		size_type length = 1;
+		for(; __slots[i].index != NO_VALUE; i = (i + 1) & mask)
+			++length;
+		__stats.chain(length, Policy::CHAIN_WARNING);
+		__slots[i].hash = tag;
+		__slots[i].index = static_cast<std::uint32_t>(index);
+	}
+
+	// construct a new last value and index it; room must be reserved
+	template<class... Args>
+	position __append(size_type hash, Args&&... args)
+	{
+		if(__size == __value_capacity)
+			__reserve_values(__value_capacity ? __value_capacity * 2 : 8);
+		value_traits::construct(__value_alloc, __values + __size, ::forward<Args>(args)...);
+		__insert_slot(__tag(hash), __size);
+		return __size++;
+	}
+
+	// smallest power of two index that holds n elements within the load factor
+	size_type __capacity_for(size_type n) const
+	{
+		size_type capacity = 8;
+		while(n >= capacity || n > capacity * __desired_load_factor)
+			capacity *= 2;
+		return capacity;
+	}
+
+	void __reserve_one()
+	{
+		if(__floor.due(__size, __capacity, __desired_load_factor))
+			rehash(__loadFloor::target(__size + 1, __desired_load_factor));
+		if(__size + 1 <= __capacity * __desired_load_factor && __size + 1 < __capacity)
+			return;
+		__resize(__capacity_for(__size + 1));
+	}
+
+	// rebuild the index at a new capacity from the hashes it already holds
+	void __resize(size_type capacity)
+	{
+		typename stats_type::time_point start = __stats.rehash_begin();
+		__indexSlot* old_slots = __slots;
+		size_type old_capacity = __capacity;
+		__slots = nullptr;
+		try
+		{
+			__allocate_index(capacity);
+		}
+		catch(...)
+		{
+			// the capacity only changes once the index exists
+			__slots = old_slots;
+			throw;
+		}
+		for(size_type i = 0; i < old_capacity; ++i)
+			if(old_slots[i].index != NO_VALUE)
+				__insert_slot(old_slots[i].hash, old_slots[i].index);
+		if(old_slots)
+			slot_traits::deallocate(__slot_alloc, old_slots, old_capacity);
+		__stats.rehash_end(start);
+	}
+
+	// grow the value array to hold at least n values
+	void __reserve_values(size_type n)
+	{
+		if(n > __value_capacity)
+			__reallocate_values(n);
+	}
+
+	// move the values into an array of n, at least __size
+	void __reallocate_values(size_type n)
+	{
+		value_type* values = value_traits::allocate(__value_alloc, n);
+		// a single memcpy when value_type is trivially relocatable; a throw
+		// leaves the old array as it was
+		try
+		{
+			__relocate_n(__value_alloc, values, __values, __size);
+		}
+		catch(...)
+		{
+			value_traits::deallocate(__value_alloc, values, n);
+			throw;
+		}
+		if(__values)
+			value_traits::deallocate(__value_alloc, __values, __value_capacity);
+		__values = values;
+		__value_capacity = n;
+		__stats.array_allocated();
+	}
+
+	void __allocate_index(size_type capacity)
+	{
+		if(capacity == 0)
+			return;
+		__slots = slot_traits::allocate(__slot_alloc, capacity);
+		for(size_type i = 0; i < capacity; ++i)
+			__slots[i].index = NO_VALUE;
+		__capacity = capacity;
+		__stats.array_allocated();
+	}
+
+	// a plain loop over the values, nothing at all when they are trivially
+	// destructible
+	void __destroy_values() noexcept
+	{
+		for(size_type i = 0; i < __size; ++i)
+			value_traits::destroy(__value_alloc, __values + i);
+		__size = 0;
+	}
+
+	void __deallocate()
+	{
+		if(__values)
+			value_traits::deallocate(__value_alloc, __values, __value_capacity);
+		if(__slots)
+			slot_traits::deallocate(__slot_alloc, __slots, __capacity);
+		__values = nullptr;
+		__slots = nullptr;
+		__value_capacity = 0;
+		__capacity = 0;
+	}
+
+	hasher __hash;
+	key_equal __equal;
+	value_allocator __value_alloc;
+	slot_allocator __slot_alloc;
+	value_type* __values;
+	__indexSlot* __slots;
+	size_type __size;
+	size_type __value_capacity;
+	size_type __capacity;
+	float __desired_load_factor;
+	__loadFloor __floor;			// minimum load factor
+	stats_type __stats;
+};
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+const typename denseStorage<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type
+	denseStorage<Key, T, Hash, KeyEqual, Allocator, Policy>::END;
+
+#endif // __DENSE_STORAGE_H__
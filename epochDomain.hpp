@@ -0,0 +1,202 @@
+#ifndef __EPOCH_DOMAIN_H__
+#define __EPOCH_DOMAIN_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Epoch based reclamation.
+//
+// Readers wrap every access to shared nodes in an epochGuard, which
+// publishes the global epoch the thread entered in. Writers hand unlinked
+// memory to retire() instead of freeing it; it is freed once the global
+// epoch has moved two steps past the retiring epoch, at which point no
+// guard that could still see it remains open.
+class epochDomain
+{
+public:
+	struct record
+	{
+		record() : epoch(0), depth(0), in_use(true), next(nullptr) {}
+
+		std::atomic<std::uint64_t> epoch;	// 0 while quiescent
+		unsigned depth;
+		std::atomic<bool> in_use;
+		record* next;
+		char pad[64];
+	};
+
+	typedef void (*deleter)(void* owner, void* ptr);
+
+	enum { RECLAIM_THRESHOLD = 64 };
+
+	epochDomain() : __global(1), __records(nullptr), __reclaim_at(RECLAIM_THRESHOLD) {}
+	epochDomain(const epochDomain&) = delete;
+	epochDomain& operator=(const epochDomain&) = delete;
+
+	~epochDomain()
+	{
+		for(std::size_t i = 0; i < __retired.size(); ++i)
+			__retired[i].fn(__retired[i].owner, __retired[i].ptr);
+		record* r = __records.load();
+		while(r)
+		{
+			record* next = r->next;
+			delete r;
+			r = next;
+		}
+	}
+
+	// claim a record for the calling thread, reusing a released one if any
+	record* acquire()
+	{
+		for(record* r = __records.load(std::memory_order_acquire); r; r = r->next)
+		{
+			bool expected = false;
+			if(!r->in_use.load(std::memory_order_relaxed)
+				&& r->in_use.compare_exchange_strong(expected, true))
+				return r;
+		}
+		record* r = new record;
+		r->next = __records.load(std::memory_order_relaxed);
+		while(!__records.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed));
+		return r;
+	}
+	void release(record* r) { r->in_use.store(false, std::memory_order_release); }
+
+	void enter(record* r)
+	{
+		if(r->depth++ == 0)
+		{
+			r->epoch.store(__global.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+	}
+	void leave(record* r)
+	{
+		if(--r->depth == 0)
+			r->epoch.store(0, std::memory_order_release);
+	}
+
+	// free ptr with fn(owner, ptr) once no reader can reach it
+	void retire(void* owner, void* ptr, deleter fn)
+	{
+		std::lock_guard<std::mutex> lock(__retired_lock);
+		__retired.push_back(retired{ owner, ptr, fn, __global.load(std::memory_order_acquire) });
+		// what is left after a pass must double before the next one, so
+		// a stalled reader cannot make every retire rescan the whole list
+		if(__retired.size() >= __reclaim_at)
+		{
+			__try_advance();
+			__reclaim(nullptr);
+			__reclaim_at = __retired.size() + (__retired.size() > std::size_t(RECLAIM_THRESHOLD) ? __retired.size() : std::size_t(RECLAIM_THRESHOLD));
+		}
+	}
+
+	// wait until everything owner retired has been freed; called when the
+	// owner goes away
+	void drain(void* owner)
+	{
+		for(;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(__retired_lock);
+				if(__reclaim(owner) == 0)
+					return;
+				__try_advance();
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	// the process wide domain shared by all concurrent tables
+	static epochDomain& global()
+	{
+		static epochDomain domain;
+		return domain;
+	}
+
+private:
+	struct retired
+	{
+		void* owner;
+		void* ptr;
+		deleter fn;
+		std::uint64_t epoch;
+	};
+
+	// bump the global epoch if every active reader has caught up with it
+	void __try_advance()
+	{
+		std::uint64_t e = __global.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		for(record* r = __records.load(std::memory_order_acquire); r; r = r->next)
+		{
+			std::uint64_t local = r->epoch.load(std::memory_order_acquire);
+			if(local != 0 && local != e)
+				return;
+		}
+		__global.compare_exchange_strong(e, e + 1);
+	}
+
+	// free what is safe; returns how many entries of owner are still pending
+	std::size_t __reclaim(void* owner)
+	{
+		std::uint64_t e = __global.load(std::memory_order_acquire);
+		std::size_t pending = 0;
+		std::size_t kept = 0;
+		for(std::size_t i = 0; i < __retired.size(); ++i)
+		{
+			if(__retired[i].epoch + 2 <= e)
+				__retired[i].fn(__retired[i].owner, __retired[i].ptr);
+			else
+			{
+				if(__retired[i].owner == owner)
+					++pending;
+				__retired[kept++] = __retired[i];
+			}
+		}
+		__retired.resize(kept);
+		return pending;
+	}
+
+	std::atomic<std::uint64_t> __global;
+	std::atomic<record*> __records;
+	std::mutex __retired_lock;
+	std::vector<retired> __retired;
+	std::size_t __reclaim_at;
+};
+
+// the calling thread's record in the global domain, released at thread exit
+inline epochDomain::record* __epoch_record()
+{
+	struct holder
+	{
+		holder() : r(nullptr) {}
+		~holder() { if(r) epochDomain::global().release(r); }
+		epochDomain::record* r;
+	};
+	static thread_local holder h;
+	if(!h.r)
+		h.r = epochDomain::global().acquire();
+	return h.r;
+}
+
+// RAII read side critical section
+class epochGuard
+{
+public:
+	epochGuard() : __record(__epoch_record()) { epochDomain::global().enter(__record); }
+	~epochGuard() { epochDomain::global().leave(__record); }
+
+	epochGuard(const epochGuard&) = delete;
+	epochGuard& operator=(const epochGuard&) = delete;
+
+private:
+	epochDomain::record* __record;
+};
+
+#endif // __EPOCH_DOMAIN_H__
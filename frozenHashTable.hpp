@@ -0,0 +1,280 @@
+#ifndef __FROZEN_HASH_TABLE_H__
+#define __FROZEN_HASH_TABLE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+
+// KEYS
+// A string key that can live in a constexpr table: a pointer and a length,
+// usually to a string literal. It does not own the characters.
+class frozen_string
+{
+public:
+	constexpr frozen_string() : __data(""), __size(0) {}
+	constexpr frozen_string(const char* s) : __data(s), __size(__length(s)) {}
+	constexpr frozen_string(const char* s, std::size_t n) : __data(s), __size(n) {}
+	frozen_string(const std::string& s) : __data(s.data()), __size(s.size()) {}
+
+	constexpr const char* data() const { return __data; }
+	constexpr std::size_t size() const { return __size; }
+
+	friend constexpr bool operator==(const frozen_string& lhs, const frozen_string& rhs)
+	{
+		if(lhs.__size != rhs.__size)
+			return false;
+		for(std::size_t i = 0; i < lhs.__size; ++i)
+			if(lhs.__data[i] != rhs.__data[i])
+				return false;
+		return true;
+	}
+	friend constexpr bool operator!=(const frozen_string& lhs, const frozen_string& rhs)
+	{ return !(lhs == rhs); }
+
+private:
+	static constexpr std::size_t __length(const char* s)
+	{
+		std::size_t n = 0;
+		while(s[n])
+			++n;
+		return n;
+	}
+
+	const char* __data;
+	std::size_t __size;
+};
+
+// HASHERS
+// std::hash is not constexpr, so frozen tables default to this one. It
+// covers integers, enums and frozen_string; other keys need a hasher with
+// a constexpr call operator.
+template<class Key>
+struct frozen_hash
+{
+	constexpr std::size_t operator()(const Key& key) const { return static_cast<std::size_t>(key); }
+};
+
+template<>
+struct frozen_hash<frozen_string>
+{
+	constexpr std::size_t operator()(const frozen_string& key) const
+	{ return __hash_bytes(key.data(), key.size()); }
+};
+
+// PERFECT HASH
+// Hash and displace: the keys are split into N buckets by their hash and
+// every bucket gets a displacement that sends all of its keys to distinct
+// free slots of the N slot table. A lookup hashes its key once, reads the
+// bucket's displacement and compares against exactly one slot.
+//
+// Buckets are placed largest first, while the table is still mostly
+// empty, trying displacements 1, 2, ... for each. A bucket of a single
+// key takes the next free slot directly and stores -(slot + 1) instead.
+enum { FROZEN_MAX_DISPLACEMENT = 1 << 16 };
+
+// the splitmix64 finalizer; __mix_hash is too weak here, since small keys
+// must land apart under every displacement
+constexpr std::uint64_t __frozen_mix(std::uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// key hash to bucket
+constexpr std::size_t __frozen_bucket(std::size_t hash, std::size_t count)
+{ return __fastrange(static_cast<std::size_t>(__frozen_mix(hash)), count); }
+
+// key hash and displacement to slot
+constexpr std::size_t __frozen_slot(std::size_t hash, std::int32_t displacement, std::size_t count)
+{ return __frozen_bucket(hash ^ (static_cast<std::size_t>(displacement) * 0x9e3779b97f4a7c15ULL), count); }
+
+template<std::size_t N>
+struct __frozenLayout
+{
+	enum { SIZE = N ? N : 1 };
+
+	std::size_t item[SIZE];				// slot to index of the element it holds
+	std::int32_t displacement[SIZE];	// by bucket
+};
+
+template<std::size_t N, class Value, class Hash, class KeyEqual>
+constexpr __frozenLayout<N> __frozen_build(const Value* items, const Hash& hash, const KeyEqual& equal)
+{
+	__frozenLayout<N> layout = {};
+	std::size_t hashes[__frozenLayout<N>::SIZE] = {}, bucket[__frozenLayout<N>::SIZE] = {},
+		members[__frozenLayout<N>::SIZE] = {};
+	bool used[__frozenLayout<N>::SIZE] = {};
+	std::size_t largest = 0;
+	for(std::size_t i = 0; i < N; ++i)
+	{
+		hashes[i] = hash(items[i].first);
+		bucket[i] = __frozen_bucket(hashes[i], N);
+		std::size_t size = ++members[bucket[i]];
+		largest = size > largest ? size : largest;
+	}
+
+	for(std::size_t size = largest; size > 1; --size)
+		for(std::size_t b = 0; b < N; ++b)
+		{
+			if(members[b] != size)
+				continue;
+			std::size_t index[__frozenLayout<N>::SIZE] = {}, slots[__frozenLayout<N>::SIZE] = {};
+			for(std::size_t i = 0, n = 0; n < size; ++i)
+				if(bucket[i] == b)
+				{
+					for(std::size_t j = 0; j < n; ++j)
+						if(hashes[index[j]] == hashes[i] && equal(items[index[j]].first, items[i].first))
+							throw std::invalid_argument("frozen_hashTable: duplicate key");
+					index[n++] = i;
+				}
+
+			std::int32_t d = 1;
+			for(std::size_t placed = 0; placed < size; ++d)
+			{
+				if(d == FROZEN_MAX_DISPLACEMENT)
+					throw std::invalid_argument("frozen_hashTable: no displacement separates the keys, check the hash");
+				for(placed = 0; placed < size; ++placed)
+				{
+					std::size_t slot = __frozen_slot(hashes[index[placed]], d, N);
+					bool taken = used[slot];
+					for(std::size_t j = 0; j < placed && !taken; ++j)
+						taken = slots[j] == slot;
+					if(taken)
+						break;
+					slots[placed] = slot;
+				}
+			}
+			layout.displacement[b] = d - 1;
+			for(std::size_t j = 0; j < size; ++j)
+			{
+				used[slots[j]] = true;
+				layout.item[slots[j]] = index[j];
+			}
+		}
+
+	std::size_t free = 0;
+	for(std::size_t i = 0; i < N; ++i)
+		if(members[bucket[i]] == 1)
+		{
+			while(used[free])
+				++free;
+			used[free] = true;
+			layout.item[free] = i;
+			layout.displacement[bucket[i]] = -static_cast<std::int32_t>(free) - 1;
+		}
+	return layout;
+}
+
+// FROZEN TABLE
+// An immutable table of exactly N elements whose layout is computed when
+// it is constructed, at compile time if it is declared constexpr:
+//
+//	constexpr frozen_hashTable<frozen_string, int, 3> opcodes = { { "add", 1 }, { "sub", 2 }, { "mul", 3 } };
+//	static_assert(opcodes.at("sub") == 2, "");
+//
+// The elements sit in an array inside the object, so there is no heap
+// memory and no startup cost, and every lookup probes exactly one slot.
+// Duplicate keys, or a list whose length is not N, are rejected; in a
+// constant expression that is a compile error.
+template<class Key,
+	class T,
+	std::size_t N,
+	class Hash = frozen_hash<Key>,
+	class KeyEqual = std::equal_to<Key>
+> class frozen_hashTable
+{
+	static_assert(N < 0x7fffffff, "frozen_hashTable: too many elements");
+
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef const value_type& const_reference;
+	typedef const value_type* const_iterator;
+	typedef const_iterator iterator;
+
+	constexpr frozen_hashTable(std::initializer_list<value_type> init,
+		const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+		: frozen_hashTable(__items(), __checked(init), hash, equal) {}
+	constexpr frozen_hashTable(const value_type (&items)[N ? N : 1],
+		const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+		: frozen_hashTable(__items(), items, hash, equal) {}
+
+	constexpr const_iterator begin() const noexcept { return __slots; }
+	constexpr const_iterator end() const noexcept { return __slots + N; }
+	constexpr const_iterator cbegin() const noexcept { return begin(); }
+	constexpr const_iterator cend() const noexcept { return end(); }
+
+	constexpr bool empty() const noexcept { return N == 0; }
+	constexpr size_type size() const noexcept { return N; }
+	constexpr size_type max_size() const noexcept { return N; }
+
+	constexpr const_iterator find(const key_type& key) const
+	{
+		if(N == 0)
+			return end();
+		std::size_t h = __hash(key);
+		std::int32_t d = __displacement[__frozen_bucket(h, N)];
+		std::size_t slot = d < 0 ? static_cast<std::size_t>(-(d + 1)) : __frozen_slot(h, d, N);
+		return __equal(__slots[slot].first, key) ? __slots + slot : end();
+	}
+	constexpr size_type count(const key_type& key) const { return find(key) != end() ? 1 : 0; }
+	constexpr bool contains(const key_type& key) const { return find(key) != end(); }
+	constexpr const mapped_type& at(const key_type& key) const
+	{
+		const_iterator it = find(key);
+		if(it == end())
+			throw std::out_of_range("frozen_hashTable::at");
+		return it->second;
+	}
+
+	constexpr hasher hash_function() const { return __hash; }
+	constexpr key_equal key_eq() const { return __equal; }
+
+private:
+	static constexpr const value_type* __checked(std::initializer_list<value_type> init)
+	{
+		if(init.size() != N)
+			throw std::invalid_argument("frozen_hashTable: initializer list length differs from N");
+		return init.begin();
+	}
+
+	struct __items {};
+	constexpr frozen_hashTable(__items, const value_type* items, const Hash& hash, const KeyEqual& equal)
+		: frozen_hashTable(items, __frozen_build<N>(items, hash, equal), hash, equal,
+			std::make_index_sequence<N>()) {}
+
+	template<std::size_t... I>
+	constexpr frozen_hashTable(const value_type* items, const __frozenLayout<N>& layout,
+		const Hash& hash, const KeyEqual& equal, std::index_sequence<I...>)
+		: __hash(hash), __equal(equal),
+		  __slots{ items[layout.item[I]]... },
+		  __displacement{ layout.displacement[I]... } {}
+
+	hasher __hash;
+	key_equal __equal;
+	value_type __slots[N ? N : 1];
+	std::int32_t __displacement[N ? N : 1];
+};
+
+// builds the table from a braced list without spelling out N:
+//	constexpr auto t = make_frozen_hashTable<int, char>({ { 1, 'a' }, { 2, 'b' } });
+template<class Key, class T, class Hash = frozen_hash<Key>, class KeyEqual = std::equal_to<Key>, std::size_t N>
+constexpr frozen_hashTable<Key, T, N, Hash, KeyEqual> make_frozen_hashTable(const pair<const Key, T> (&items)[N],
+	const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+{ return frozen_hashTable<Key, T, N, Hash, KeyEqual>(items, hash, equal); }
+
+#endif // __FROZEN_HASH_TABLE_H__
@@ -0,0 +1,453 @@
+#ifndef __HASH_POLICY_H__
+#define __HASH_POLICY_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// STORAGE LAYOUTS
+// declared here so that a policy can name its storage
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class chainedStorage;
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class flatStorage;
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class denseStorage;
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class soaStorage;
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class smallStorage;
+
+// HELPERS
+// smallest power of two >= n
+inline std::size_t __next_pow2(std::size_t n)
+{
+	std::size_t p = 1;
+	while(p < n) p <<= 1;
+	return p;
+}
+
+// spread the bits of a hash so that masking off the low bits is safe even
+// for identity hashes such as std::hash<int>
+inline std::size_t __mix_hash(std::size_t h)
+{
+	std::uint64_t x = h;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return static_cast<std::size_t>(x);
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 __uint128;
+#endif
+
+// the high 64 bits of the 128 bit product a * b; from 32 bit halves where
+// there is no 128 bit integer, as on MSVC and 32 bit targets
+constexpr inline std::uint64_t __mul_hi64(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	return static_cast<std::uint64_t>((static_cast<__uint128>(a) * b) >> 64);
+#else
+	std::uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+	std::uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+	std::uint64_t hi_lo = a_hi * b_lo;
+	std::uint64_t cross = ((a_lo * b_lo) >> 32) + (hi_lo & 0xffffffffULL) + a_lo * b_hi;
+	return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Lemire's multiply-shift range reduction of a hash to [0, n); the hash is
+// taken as a fraction of the whole size_t range
+constexpr inline std::size_t __fastrange(std::size_t hash, std::size_t n)
+{
+	return static_cast<std::size_t>(__mul_hi64(static_cast<std::uint64_t>(hash) << (64 - sizeof(std::size_t) * 8), n));
+}
+
+// FNV-1a over a byte range
+constexpr inline std::size_t __hash_bytes(const char* p, std::size_t n)
+{
+	std::uint64_t h = 14695981039346656037ULL;
+	for(std::size_t i = 0; i < n; ++i)
+		h = (h ^ static_cast<unsigned char>(p[i])) * 1099511628211ULL;
+	return static_cast<std::size_t>(h);
+}
+
+// The minimum load factor of a storage. An erase that leaves fewer
+// elements per bucket than min_load_factor only marks the table, and the
+// next insert rehashes it to half the maximum load factor. Shrinking on
+// the erase itself would move elements under loops that erase as they
+// iterate. At most a quarter of the maximum load factor is used, so that
+// a shrunk table sits well clear of both thresholds; 0 never shrinks.
+struct __loadFloor
+{
+	__loadFloor() : min_load_factor(0.0f), pending(false) {}
+	explicit __loadFloor(float ml) : min_load_factor(ml), pending(false) {}
+
+	float bound(float max_load_factor) const
+	{
+		float quarter = max_load_factor / 4;
+		return min_load_factor < quarter ? min_load_factor : quarter;
+	}
+
+	// after an erase left size elements in buckets
+	void erased(std::size_t size, std::size_t buckets, float max_load_factor)
+	{
+		if(min_load_factor > 0 && size < buckets * bound(max_load_factor))
+			pending = true;
+	}
+
+	// before an insert into a table of size elements: whether to shrink
+	// first, which clears the mark
+	bool due(std::size_t size, std::size_t buckets, float max_load_factor)
+	{
+		if(!pending)
+			return false;
+		pending = false;
+		return size < buckets * bound(max_load_factor);
+	}
+
+	// the bucket count to shrink to
+	static std::size_t target(std::size_t size, float max_load_factor)
+		{ return static_cast<std::size_t>(2 * size / max_load_factor) + 1; }
+
+	float min_load_factor;
+	bool pending;
+};
+
+// HASHERS
+// transparent string hash: std::string and C strings with the same
+// characters hash alike, so together with std::equal_to<> a
+// hashTable<std::string, ...> can be searched without building a string
+struct string_hash
+{
+	typedef void is_transparent;
+
+	std::size_t operator()(const std::string& s) const { return __hash_bytes(s.data(), s.size()); }
+	std::size_t operator()(const char* s) const { return __hash_bytes(s, std::strlen(s)); }
+};
+
+// SipHash-C-D of a byte range under the 128 bit key (k0, k1), reading
+// words little endian
+inline void __sip_round(std::uint64_t& v0, std::uint64_t& v1, std::uint64_t& v2, std::uint64_t& v3)
+{
+	v0 += v1; v1 = (v1 << 13) | (v1 >> 51); v1 ^= v0; v0 = (v0 << 32) | (v0 >> 32);
+	v2 += v3; v3 = (v3 << 16) | (v3 >> 48); v3 ^= v2;
+	v0 += v3; v3 = (v3 << 21) | (v3 >> 43); v3 ^= v0;
+	v2 += v1; v1 = (v1 << 17) | (v1 >> 47); v1 ^= v2; v2 = (v2 << 32) | (v2 >> 32);
+}
+
+template<int C, int D>
+std::uint64_t __siphash(const char* p, std::size_t n, std::uint64_t k0, std::uint64_t k1)
+{
+	std::uint64_t v0 = 0x736f6d6570736575ULL ^ k0, v1 = 0x646f72616e646f6dULL ^ k1;
+	std::uint64_t v2 = 0x6c7967656e657261ULL ^ k0, v3 = 0x7465646279746573ULL ^ k1;
+	const char* end = p + (n & ~std::size_t(7));
+	for(; p != end; p += 8)
+	{
+		std::uint64_t m;
+		std::memcpy(&m, p, 8);
+		v3 ^= m;
+		for(int i = 0; i < C; ++i)
+			__sip_round(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+	std::uint64_t b = std::uint64_t(n) << 56;
+	for(std::size_t i = 0; i < (n & 7); ++i)
+		b |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+	v3 ^= b;
+	for(int i = 0; i < C; ++i)
+		__sip_round(v0, v1, v2, v3);
+	v0 ^= b;
+	v2 ^= 0xff;
+	for(int i = 0; i < D; ++i)
+		__sip_round(v0, v1, v2, v3);
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// a fresh 64 bit seed per call: a secret drawn from std::random_device once
+// per process, stepped and mixed so that seeds cannot be told apart
+inline std::uint64_t __random_seed()
+{
+	static const std::uint64_t secret = []
+	{
+		std::random_device device;
+		return (std::uint64_t(device()) << 32) ^ device();
+	}();
+	static std::atomic<std::uint64_t> step(0);
+	std::uint64_t x = secret + step.fetch_add(0x9e3779b97f4a7c15ULL, std::memory_order_relaxed);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// Keyed hash for keys an attacker may choose: SipHash-1-3 under a random
+// 128 bit seed, so colliding keys cannot be precomputed. Hashes strings
+// (transparently, like string_hash), integers, enums and pointers.
+// reseed() draws a new seed; chained storage calls it when an insert
+// makes a chain longer than its policy's RESEED_CHAIN.
+struct seeded_hash
+{
+	typedef void is_transparent;
+
+	seeded_hash() : k0(__random_seed()), k1(__random_seed()) {}
+	explicit seeded_hash(std::uint64_t seed0, std::uint64_t seed1 = 0) : k0(seed0), k1(seed1) {}
+
+	std::size_t operator()(const std::string& s) const { return __siphash<1, 3>(s.data(), s.size(), k0, k1); }
+	std::size_t operator()(const char* s) const { return __siphash<1, 3>(s, std::strlen(s), k0, k1); }
+	template<class K, class = typename std::enable_if<
+		std::is_integral<K>::value || std::is_enum<K>::value || std::is_pointer<K>::value>::type>
+	std::size_t operator()(K key) const
+	{
+		std::uint64_t word = __word(key);
+		char bytes[8];
+		std::memcpy(bytes, &word, 8);
+		return __siphash<1, 3>(bytes, 8, k0, k1);
+	}
+
+	void reseed()
+	{
+		k0 = __random_seed();
+		k1 = __random_seed();
+	}
+
+	std::uint64_t k0, k1;
+
+private:
+	template<class K>
+	static std::uint64_t __word(K key) { return static_cast<std::uint64_t>(key); }
+	template<class K>
+	static std::uint64_t __word(K* key) { return reinterpret_cast<std::uintptr_t>(key); }
+};
+
+// whether a Hash can draw a new seed with reseed()
+template<class Hash, class = void>
+struct __is_reseedable : std::false_type {};
+template<class Hash>
+struct __is_reseedable<Hash, decltype(std::declval<Hash&>().reseed())> : std::true_type {};
+
+// BUCKET INDEX
+// A bucket index turns a hash into a bucket number for a table of the
+// count it was last reset() to. round(n) is the bucket count it wants
+// for at least n buckets. Chained storage takes the one named by its
+// policy's bucket_index typedef.
+
+// power of two counts, masking off the low bits of the mixed hash
+struct pow2_index
+{
+	pow2_index() : mask(0) {}
+
+	static std::size_t round(std::size_t n) { return __next_pow2(n); }
+	void reset(std::size_t count) { mask = count - 1; }
+	std::size_t operator()(std::size_t hash) const { return __mix_hash(hash) & mask; }
+
+	std::size_t mask;
+};
+
+// any count, mapped with Lemire's multiply-shift range reduction on the
+// mixed hash
+struct fastrange_index
+{
+	fastrange_index() : count(0) {}
+
+	static std::size_t round(std::size_t n) { return n; }
+	void reset(std::size_t n) { count = n; }
+	std::size_t operator()(std::size_t hash) const
+	{ return __fastrange(__mix_hash(hash), count); }
+
+	std::size_t count;
+};
+
+template<std::size_t P>
+std::size_t __mod_prime(std::size_t hash) { return hash % P; }
+
+// prime counts from a table of roughly doubling primes. Each prime has its
+// own modulo function with the divisor known at compile time, so the
+// compiler turns the division into a multiply.
+struct prime_index
+{
+	enum { PRIMES = 62 };
+
+	prime_index() : mod(&__mod_prime<2ULL>) {}
+
+	static std::size_t round(std::size_t n)
+	{
+		const std::size_t* p = std::lower_bound(primes(), primes() + PRIMES - 1, n);
+		return *p;
+	}
+	void reset(std::size_t count)
+	{ mod = mods()[std::lower_bound(primes(), primes() + PRIMES - 1, count) - primes()]; }
+	std::size_t operator()(std::size_t hash) const { return mod(hash); }
+
+	static const std::size_t* primes()
+	{
+		static const std::size_t table[PRIMES] =
+		{
+			2ULL, 5ULL, 11ULL, 23ULL, 47ULL, 97ULL, 197ULL, 397ULL, 797ULL, 1597ULL, 3203ULL, 6421ULL,
+			12853ULL, 25717ULL, 51437ULL, 102877ULL, 205759ULL, 411527ULL, 823117ULL, 1646237ULL,
+			3292489ULL, 6584983ULL, 13169977ULL, 26339969ULL, 52679969ULL, 105359939ULL, 210719881ULL,
+			421439783ULL, 842879579ULL, 1685759167ULL, 3371518343ULL, 6743036717ULL, 13486073473ULL,
+			26972146961ULL, 53944293929ULL, 107888587883ULL, 215777175787ULL, 431554351609ULL,
+			863108703229ULL, 1726217406467ULL, 3452434812973ULL, 6904869625999ULL, 13809739252051ULL,
+			27619478504183ULL, 55238957008387ULL, 110477914016779ULL, 220955828033581ULL,
+			441911656067171ULL, 883823312134381ULL, 1767646624268779ULL, 3535293248537579ULL,
+			7070586497075177ULL, 14141172994150357ULL, 28282345988300791ULL, 56564691976601587ULL,
+			113129383953203213ULL, 226258767906406483ULL, 452517535812813007ULL, 905035071625626043ULL,
+			1810070143251252131ULL, 3620140286502504283ULL, 7240280573005008577ULL
+		};
+		return table;
+	}
+
+	typedef std::size_t (*mod_function)(std::size_t);
+	static const mod_function* mods()
+	{
+		static const mod_function table[PRIMES] =
+		{
+			&__mod_prime<2ULL>, &__mod_prime<5ULL>, &__mod_prime<11ULL>, &__mod_prime<23ULL>,
+			&__mod_prime<47ULL>, &__mod_prime<97ULL>, &__mod_prime<197ULL>, &__mod_prime<397ULL>,
+			&__mod_prime<797ULL>, &__mod_prime<1597ULL>, &__mod_prime<3203ULL>, &__mod_prime<6421ULL>,
+			&__mod_prime<12853ULL>, &__mod_prime<25717ULL>, &__mod_prime<51437ULL>, &__mod_prime<102877ULL>,
+			&__mod_prime<205759ULL>, &__mod_prime<411527ULL>, &__mod_prime<823117ULL>,
+			&__mod_prime<1646237ULL>, &__mod_prime<3292489ULL>, &__mod_prime<6584983ULL>,
+			&__mod_prime<13169977ULL>, &__mod_prime<26339969ULL>, &__mod_prime<52679969ULL>,
+			&__mod_prime<105359939ULL>, &__mod_prime<210719881ULL>, &__mod_prime<421439783ULL>,
+			&__mod_prime<842879579ULL>, &__mod_prime<1685759167ULL>, &__mod_prime<3371518343ULL>,
+			&__mod_prime<6743036717ULL>, &__mod_prime<13486073473ULL>, &__mod_prime<26972146961ULL>,
+			&__mod_prime<53944293929ULL>, &__mod_prime<107888587883ULL>, &__mod_prime<215777175787ULL>,
+			&__mod_prime<431554351609ULL>, &__mod_prime<863108703229ULL>, &__mod_prime<1726217406467ULL>,
+			&__mod_prime<3452434812973ULL>, &__mod_prime<6904869625999ULL>, &__mod_prime<13809739252051ULL>,
+			&__mod_prime<27619478504183ULL>, &__mod_prime<55238957008387ULL>,
+			&__mod_prime<110477914016779ULL>, &__mod_prime<220955828033581ULL>,
+			&__mod_prime<441911656067171ULL>, &__mod_prime<883823312134381ULL>,
+			&__mod_prime<1767646624268779ULL>, &__mod_prime<3535293248537579ULL>,
+			&__mod_prime<7070586497075177ULL>, &__mod_prime<14141172994150357ULL>,
+			&__mod_prime<28282345988300791ULL>, &__mod_prime<56564691976601587ULL>,
+			&__mod_prime<113129383953203213ULL>, &__mod_prime<226258767906406483ULL>,
+			&__mod_prime<452517535812813007ULL>, &__mod_prime<905035071625626043ULL>,
+			&__mod_prime<1810070143251252131ULL>, &__mod_prime<3620140286502504283ULL>,
+			&__mod_prime<7240280573005008577ULL>
+		};
+		return table;
+	}
+
+	mod_function mod;
+};
+
+// POLICIES
+// A policy picks the storage layout behind a hashTable. To change a single
+// option derive from one of these and override it.
+
+// separate chaining: one heap node per element, each bucket a singly linked list
+struct chained_policy
+{
+	typedef prime_index bucket_index;
+
+	enum
+	{
+		INCREMENTAL_REHASH = 0,	// spread rehashing over later inserts
+		REHASH_STEP = 8,		// old buckets migrated per insert when incremental
+		NODE_POOL = 0,			// carve nodes from slabs instead of one allocation each
+		POOL_MAX_SLAB = 4096,	// with NODE_POOL, the most nodes a slab grows to
+		CACHE_HASH = -1,		// keep each key's hash in its node: 1 always, 0 never,
+								// -1 unless Hash is std::hash of a scalar
+		STATS = 0,				// keep the counters reported by stats()
+		CHAIN_WARNING = 32,		// with STATS, debug builds warn once past this chain length
+		RESEED_CHAIN = 16		// with a Hash that has reseed(), reseed and rehash once an
+								// insert makes a chain longer than this; 0 never
+	};
+
+	template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+	using storage = chainedStorage<Key, T, Hash, KeyEqual, Allocator, Policy>;
+};
+
+// separate chaining with incremental rehashing, for tables where a single
+// insert must never pay for rebuilding the whole bucket array
+struct incremental_chained_policy : chained_policy
+{
+	enum { INCREMENTAL_REHASH = 1 };
+};
+
+// separate chaining with nodes drawn from a slab pool, for tables with
+// heavy insert/erase churn
+struct pooled_chained_policy : chained_policy
+{
+	enum { NODE_POOL = 1 };
+};
+
+// pooled chaining with slabs of up to 65536 nodes, megabytes each, so that
+// with huge_page_allocator the nodes sit on huge pages as the buckets do
+struct huge_page_chained_policy : pooled_chained_policy
+{
+	enum { POOL_MAX_SLAB = 1 << 16 };
+};
+
+// open addressing: elements live inline in one contiguous slot array and
+// collisions are resolved by linear probing
+struct open_addressing_policy
+{
+	enum
+	{
+		STATS = 0,				// keep the counters reported by stats()
+		CHAIN_WARNING = 8		// with STATS, debug builds warn once past this many groups
+	};
+
+	template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+	using storage = flatStorage<Key, T, Hash, KeyEqual, Allocator, Policy>;
+};
+
+// values packed in one array with an open addressing index beside it, for
+// tables that are scanned in full more often than they are erased from
+struct dense_policy
+{
+	enum
+	{
+		STATS = 0,				// keep the counters reported by stats()
+		CHAIN_WARNING = 32		// with STATS, debug builds warn once past this many index slots
+	};
+
+	template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+	using storage = denseStorage<Key, T, Hash, KeyEqual, Allocator, Policy>;
+};
+
+// open addressing with keys and mapped values in separate arrays, for small
+// keys with large values: probes never load a mapped value
+struct soa_policy
+{
+	enum
+	{
+		STATS = 0,				// keep the counters reported by stats()
+		CHAIN_WARNING = 8		// with STATS, debug builds warn once past this many groups
+	};
+
+	template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+	using storage = soaStorage<Key, T, Hash, KeyEqual, Allocator, Policy>;
+};
+
+// up to N elements kept inside the table and searched linearly, for the
+// many tiny maps that should never allocate; past N the elements move to
+// the storage of Large
+template<std::size_t N = 8, class Large = chained_policy>
+struct small_policy
+{
+	typedef Large large_policy;
+
+	enum
+	{
+		INLINE_CAPACITY = N		// elements held before moving to large_policy
+	};
+
+	template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+	using storage = smallStorage<Key, T, Hash, KeyEqual, Allocator, Policy>;
+};
+
+#endif // __HASH_POLICY_H__
@@ -1,21 +1,80 @@
 #ifndef __HASH__TABLE_H_
 #define __HASH__TABLE_H_
 
+#include <cmath>
 #include <iterator>
 #include <memory>
 #include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "chainedStorage.hpp"
+#include "flatStorage.hpp"
+#include "denseStorage.hpp"
+#include "smallStorage.hpp"
+#include "soaStorage.hpp"
+#include "nodeHandle.hpp"
+#include "parallel.hpp"
+
+// an argument that calls f only when a value is built from it, so that
+// upsert can hand its init function to try_emplace
+template<class F>
+struct __lazyValue
+{
+	typedef decltype(std::declval<F&>()()) result_type;
+
+	operator result_type() const { return f(); }
+
+	F& f;
+};
+
+// What a storage's value() hands out. Most storages return value_type&; one
+// without value_type objects, like soaStorage, names proxy reference and
+// const_reference types instead, and its iterators return the proxy inside
+// an arrow_proxy from operator->.
+template<class Storage, class = void>
+struct __storageReference
+{
+	typedef typename Storage::value_type& reference;
+	typedef const typename Storage::value_type& const_reference;
+	typedef typename Storage::value_type* pointer;
+	typedef const typename Storage::value_type* const_pointer;
+
+	static pointer address(reference r) { return std::addressof(r); }
+	static const_pointer address(const_reference r) { return std::addressof(r); }
+};
+
+template<class Storage>
+struct __storageReference<Storage,
+	typename std::enable_if<!std::is_reference<typename Storage::reference>::value>::type>
+{
+	typedef typename Storage::reference reference;
+	typedef typename Storage::const_reference const_reference;
+	typedef arrow_proxy<reference> pointer;
+	typedef arrow_proxy<const_reference> const_pointer;
+
+	static pointer address(reference r) { return pointer{r}; }
+	static const_pointer address(const_reference r) { return const_pointer{r}; }
+};
 
 template<class Key,
 	class T = Key,
 	class Hash = std::hash<Key>,
 	class KeyEqual = std::equal_to<Key>,
-	class Allocator = std::allocator<pair<const Key, T> >
+	class Allocator = std::allocator<pair<const Key, T> >,
+	class Policy = chained_policy
 > class hashTable
 {
-	struct hashNode;
+	typedef typename Policy::template storage<Key, T, Hash, KeyEqual, Allocator, Policy> storage_type;
+	typedef typename storage_type::position position;
+	typedef typename storage_type::local_position local_position;
+	typedef __storageReference<storage_type> storage_reference;
+
 public:
-	enum { DEFAULT_BUCKET_SIZE = 13 };
+	enum { DEFAULT_BUCKET_SIZE = 13, BATCH_SIZE = 16 };
 
 	typedef Key key_type;
 	typedef T mapped_type;
@@ -25,8 +84,9 @@ public:
 	typedef Hash hasher;
 	typedef KeyEqual key_equal;
 	typedef Allocator allocator_type;
-	typedef value_type& reference;
-	typedef const value_type& const_reference;
+	typedef Policy policy_type;
+	typedef typename storage_reference::reference reference;
+	typedef typename storage_reference::const_reference const_reference;
 	typedef typename std::allocator_traits<Allocator>::pointer pointer;
 	typedef typename std::allocator_traits<Allocator>::const_pointer const_pointer;
 
@@ -35,8 +95,20 @@ public:
 	class local_iterator;
 	class const_local_iterator;
 
+	typedef node_handle<Key, T, typename storage_type::node, Allocator> node_type;
+	struct insert_return_type;
+
+private:
+	// enables the transparent overloads for a key argument of type K;
+	// iterators are excluded so erase(it) keeps its usual meaning
+	template<class K>
+	using __transparent_key = typename std::enable_if<
+		__is_transparent<Hash>::value && __is_transparent<KeyEqual>::value
+		&& !std::is_convertible<K, iterator>::value
+		&& !std::is_convertible<K, const_iterator>::value>::type;
+
+public:
 	hashTable() : hashTable(size_type(DEFAULT_BUCKET_SIZE)) {}
-	// TODO
 	explicit hashTable(size_type bucket_count,
 		const Hash& hash = Hash(),
 		const KeyEqual& equal = KeyEqual(),
@@ -50,10 +122,8 @@ public:
 		const Allocator& alloc)
 		: hashTable(bucket_count, hash, KeyEqual(), alloc) {}
 
-	// TODO
 	explicit hashTable(const Allocator& alloc);
 
-	// TODO
 	template<class InputIt>
 	hashTable(InputIt first, InputIt last,
 		size_type bucket_count = DEFAULT_BUCKET_SIZE,
@@ -72,23 +142,30 @@ public:
 	hashTable( InputIt first, InputIt last,
 		size_type bucket_count,
 		const Hash& hash,
-		const Allocator& alloc ) 
-		: hashTable(first, last, 
+		const Allocator& alloc )
+		: hashTable(first, last,
 		  bucket_count, hash, KeyEqual(), alloc) {}
 
-	// TODO
+	// build from a range on several threads, see insert(first, last, threads)
+	template<class InputIt>
+	hashTable(InputIt first, InputIt last,
+		thread_count threads,
+		size_type bucket_count = DEFAULT_BUCKET_SIZE,
+		const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(),
+		const Allocator& alloc = Allocator() );
+
 	hashTable(const hashTable& other);
 	hashTable(const hashTable& other, const Allocator& alloc);
 	hashTable(hashTable&& other);
 	hashTable(hashTable&& other, const Allocator& alloc);
 
-	// TODO
 	hashTable(std::initializer_list<value_type> init,
 		size_type bucket_count = DEFAULT_BUCKET_SIZE,
 		const Hash& hash = Hash(),
 		const KeyEqual& equal = KeyEqual(),
 		const Allocator& alloc = Allocator() );
-	
+
 	hashTable(std::initializer_list<value_type> init,
 		size_type bucket_count,
 		const Allocator& alloc)
@@ -97,48 +174,51 @@ public:
 	hashTable( std::initializer_list<value_type> init,
 		size_type bucket_count,
 		const Hash& hash,
-		const Allocator& alloc ) 
-		: hashTable(init, bucket_count, 
+		const Allocator& alloc )
+		: hashTable(init, bucket_count,
 		  hash, KeyEqual(), alloc) {}
 
-	// TODO
 	hashTable& operator=(const hashTable&);
+	hashTable& operator=(hashTable&&);
+
+	allocator_type get_allocator() const;
 
-	// TODO
 	iterator begin() noexcept;
 	const_iterator begin() const noexcept;
 	const_iterator cbegin() const noexcept;
 
-	// TODO
 	iterator end();
 	const_iterator end() const;
 	const_iterator cend() const;
 
-	// TODO
 	bool empty() const noexcept;
 
-	// TODO
 	size_type size() const noexcept;
 	size_type max_size() const noexcept;
 
-	// TODO
 	void clear() noexcept;
 
-	// TODO
 	pair<iterator, bool> insert(const value_type& value);
-	template<class P>
+	template<class P,
+		class = typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type>
 	pair<iterator, bool> insert(P&& value);
 
 	// insert with hint for start
 	iterator insert(const_iterator hint, const value_type& value);
-	template<class P>
+	template<class P,
+		class = typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type>
 	iterator insert(const_iterator hint, P&& value);
 
 	template<class InputIt>
 	void insert(InputIt first, InputIt last);
 	void insert(std::initializer_list<value_type> ilist);
 
-	// TODO
+	// insert a range on several threads; chained storage splits the whole
+	// build, the other layouts only hash in parallel. Input iterators fall
+	// back to insert(first, last).
+	template<class InputIt>
+	void insert(InputIt first, InputIt last, thread_count threads);
+
 	template <class M>
 	pair<iterator, bool> insert_or_assign(const key_type& k, M&& obj);
 	template <class M>
@@ -148,13 +228,10 @@ public:
 	template <class M>
 	iterator insert_or_assign(const_iterator hint, key_type&& k, M&& obj);
 
-	// TODO
 	template<class... Args>
 	pair<iterator, bool> emplace(Args&&... args);
-	// TODO
 	template<class... Args>
 	iterator emplace(const_iterator hint, Args&&... args);
-	// TODO
 	template <class... Args>
 	pair<iterator, bool> try_emplace(const key_type& k, Args&&... args);
 	template <class... Args>
@@ -164,34 +241,109 @@ public:
 	template <class... Args>
 	iterator try_emplace(const_iterator hint, key_type&& k, Args&&... args);
 
-	// TODO
 	iterator erase(const_iterator pos);
 	iterator erase(const_iterator first, const_iterator last);
 	size_type erase(const key_type& key);
 
-	// TODO
+	// NODES
+	// take an element out of the table without destroying it, and put it
+	// into this or another table with an equal allocator; see node_handle
+	node_type extract(const_iterator pos);
+	node_type extract(const key_type& key);
+	insert_return_type insert(node_type&& node);
+	iterator insert(const_iterator hint, node_type&& node);
+	// move over every element of source whose key is not present here
+	void merge(hashTable& source);
+	void merge(hashTable&& source);
+
+	// AGGREGATION
+	// counting and group-by in one hash and one probe per row. upsert
+	// inserts init() for a missing key and calls update(mapped) on a present
+	// one; merge_value inserts value or calls combine(mapped, value).
+	template<class Init, class Update>
+	pair<iterator, bool> upsert(const key_type& k, Init init, Update update);
+	template<class Init, class Update>
+	pair<iterator, bool> upsert(key_type&& k, Init init, Update update);
+	template<class V, class Combine>
+	pair<iterator, bool> merge_value(const key_type& k, V&& value, Combine combine);
+	template<class V, class Combine>
+	pair<iterator, bool> merge_value(key_type&& k, V&& value, Combine combine);
+	// merge_value(p.first, p.second, combine) for every pair p of a range,
+	// hashed and prefetched BATCH_SIZE at a time like insert_batch
+	template<class ForwardIt, class Combine>
+	void merge_values(ForwardIt first, ForwardIt last, Combine combine);
+	// the same on several threads: each merges its part of the range into a
+	// table of its own, and those are merged into this one with combine,
+	// which must therefore also accept a mapped_type as its second argument
+	template<class ForwardIt, class Combine>
+	void merge_values(ForwardIt first, ForwardIt last, Combine combine, thread_count threads);
+
 	void swap(hashTable& other);
 
-	// TODO
 	mapped_type& at(const key_type& key);
 	const mapped_type& at(const key_type& key) const;
-	// TODO
 	mapped_type& operator[](const key_type& key);
 	mapped_type& operator[](key_type&& key);
 
-	// TODO
 	size_type count(const key_type& key) const;
+	bool contains(const key_type& key) const;
 
-	// TODO
 	iterator find(const key_type& key);
 	const_iterator find(const key_type& key) const;
 
-	// TODO
 	pair<iterator, iterator> equal_range(const key_type& key);
 	pair<const_iterator, const_iterator> equal_range(const key_type& key) const;
 
+	// TRANSPARENT LOOKUP
+	// available when Hash and KeyEqual both define is_transparent; the key
+	// is hashed and compared as given and only turned into a key_type when
+	// try_emplace inserts it
+	template<class K, class = __transparent_key<K>, class... Args>
+	pair<iterator, bool> try_emplace(K&& k, Args&&... args);
+	template<class K, class = __transparent_key<K> >
+	size_type erase(const K& key);
+	template<class K, class = __transparent_key<K> >
+	node_type extract(const K& key);
+	template<class K, class = __transparent_key<K>, class Init, class Update>
+	pair<iterator, bool> upsert(K&& k, Init init, Update update);
+	template<class K, class = __transparent_key<K>, class V, class Combine>
+	pair<iterator, bool> merge_value(K&& k, V&& value, Combine combine);
+
+	template<class K, class = __transparent_key<K> >
+	mapped_type& at(const K& key);
+	template<class K, class = __transparent_key<K> >
+	const mapped_type& at(const K& key) const;
+
+	template<class K, class = __transparent_key<K> >
+	size_type count(const K& key) const;
+	template<class K, class = __transparent_key<K> >
+	bool contains(const K& key) const;
+
+	template<class K, class = __transparent_key<K> >
+	iterator find(const K& key);
+	template<class K, class = __transparent_key<K> >
+	const_iterator find(const K& key) const;
+
+	template<class K, class = __transparent_key<K> >
+	pair<iterator, iterator> equal_range(const K& key);
+	template<class K, class = __transparent_key<K> >
+	pair<const_iterator, const_iterator> equal_range(const K& key) const;
+
+	// BATCH LOOKUP
+	// keys are taken BATCH_SIZE at a time: all of them are hashed and their
+	// buckets prefetched before any is looked up, so the cache misses of a
+	// batch overlap instead of following one another
+	template<class ForwardIt, class OutputIt>
+	OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out);
+	template<class ForwardIt, class OutputIt>
+	OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const;
+	template<class ForwardIt>
+	size_type count_batch(ForwardIt first, ForwardIt last) const;
+	// insert a range of value_type the same way
+	template<class ForwardIt>
+	void insert_batch(ForwardIt first, ForwardIt last);
+
 	// BUCKET INTERFACE
-		// TODO
 		local_iterator begin(size_type n);
 		const_local_iterator begin(size_type n) const;
 		const_local_iterator cbegin(size_type n) const;
@@ -206,161 +358,127 @@ public:
 		size_type bucket(const key_type& key) const;
 
 	// HASH POLICY
-		// TODO
 		float load_factor() const;
 		float max_load_factor() const;
 		void max_load_factor(float ml);
+		// once erases leave fewer elements per bucket than this, the next
+		// insert shrinks the table, and clear() frees its arrays; 0, the
+		// default, never shrinks
+		float min_load_factor() const;
+		void min_load_factor(float ml);
 
 		void rehash(size_type count);
 		void reserve(size_type count);
+		// on several threads for chained storage, the same as above otherwise
+		void rehash(size_type count, thread_count threads);
+		void reserve(size_type count, thread_count threads);
+		// rehash(0): the fewest buckets that hold size() within the load factor
+		void shrink_to_fit();
+
+	// STATISTICS
+		hashTableStats stats() const;
+		// heap bytes held, see tableStats.hpp
+		hashTableMemory memory_usage() const;
 
 	// OBSERVERS
-		// TODO
 		hasher hash_function() const;
 		key_equal key_eq() const;
 
 	// COMPARE
-		// TODO
 		template<class UKey,
 			class U,
 			class UHash,
 			class UKeyEqual,
-			class UAllocator>
-		friend bool operator==(hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& lhs, hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& rhs);
+			class UAllocator,
+			class UPolicy>
+		friend bool operator==(const hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& lhs, const hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& rhs);
 		template<class UKey,
 			class U,
 			class UHash,
 			class UKeyEqual,
-			class UAllocator>
-		friend bool operator!=(hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& lhs, hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& rhs);
+			class UAllocator,
+			class UPolicy>
+		friend bool operator!=(const hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& lhs, const hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& rhs);
 		template<class UKey,
 			class U,
 			class UHash,
 			class UKeyEqual,
-			class UAllocator>
-		friend void swap(hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& lhs, hashTable<UKey, U, UHash, UKeyEqual, UAllocator>& rhs);
+			class UAllocator,
+			class UPolicy>
+		friend void swap(hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& lhs, hashTable<UKey, U, UHash, UKeyEqual, UAllocator, UPolicy>& rhs);
 
-	// TODO
 	~hashTable();
 
 private:
-	hashNode** __buckets;
-	size_type __bucket_count;
-	float __desired_load_factor;
-};
+	iterator __make_iterator(position p) const { return iterator(&__storage, p); }
 
-// Node
-template<class Key,
-	class T,
-	class Hash,
-	class KeyEqual,
-	class Allocator>
-struct hashTable<Key, T, Hash, KeyEqual, Allocator>::hashNode
-{
-	explicit hashNode();
+	// hash and prefetch up to BATCH_SIZE keys, then call f(element, hash) on each
+	template<class ForwardIt, class KeyOf, class F>
+	void __for_each_hashed(ForwardIt first, ForwardIt last, KeyOf key_of, F f) const;
 
-	hashTable::value_type value;
-	hashNode* next;
-}; // End Node
+	template<class K, class Init, class Update>
+	pair<iterator, bool> __upsert(K&& k, Init& init, Update& update);
+	template<class K, class V, class Combine>
+	pair<iterator, bool> __merge_value(K&& k, V&& value, Combine& combine);
 
-template<class Key,
-	class T,
-	class Hash,
-	class KeyEqual,
-	class Allocator>
-hashTable<Key, T, Hash, KeyEqual, Allocator>::hashNode::hashNode()
-	: value(), next(nullptr) {}
+	template<class InputIt>
+	void __insert_parallel(InputIt first, InputIt last, thread_count threads, std::input_iterator_tag);
+	template<class ForwardIt>
+	void __insert_parallel(ForwardIt first, ForwardIt last, thread_count threads, std::forward_iterator_tag);
+
+	storage_type __storage;
+};
 
 // Iterator
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-class hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator
-	: std::iterator<std::forward_iterator_tag, typename hashTable<Key, T, Hash, KeyEqual, Allocator>::hashNode*>
+	class Allocator,
+	class Policy>
+class hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator
 {
+	friend class hashTable;
+	friend class const_iterator;
 public:
-	typedef hashNode* value_type;
-	typedef hashNode** pointer;
-	typedef hashNode*& reference;
-	typedef hashNode const& const_reference;
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename hashTable::value_type value_type;
+	typedef typename hashTable::difference_type difference_type;
+	typedef typename storage_reference::pointer pointer;
+	typedef typename storage_reference::reference reference;
 
 	constexpr iterator()
-		: iterator(nullptr, 0) {}
-	constexpr iterator(hashNode** __ref_)
-		: iterator(__ref_, 0) {}
-	explicit constexpr iterator(hashNode** __ref_, hashTable::size_type __offset_)
-		: ref(__ref_), offset(__offset_) {}
-
-	iterator& operator=(const iterator& other);
+		: table(nullptr), pos() {}
 
 	iterator& operator++();
 	iterator operator++(int);
-	
+
 	pointer operator->() const;
 	reference operator*() const;
 
-	~iterator();
-
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator==(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::iterator& rhs);
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator!=(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::iterator& rhs);
+	friend bool operator==(const iterator& lhs, const iterator& rhs)
+		{ return lhs.pos == rhs.pos; }
+	friend bool operator!=(const iterator& lhs, const iterator& rhs)
+		{ return lhs.pos != rhs.pos; }
 
 private:
-	hashNode** ref;
-	hashTable::size_type offset;
-};
-
-// Compare Normal Iterators
-	template<class Key,
-		class T,
-		class Hash,
-		class KeyEqual,
-		class Allocator>
-	inline bool operator==(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& rhs)
-	{ return (lhs.ref == rhs.ref) && (lhs.offset == rhs.offset); }
+	iterator(const storage_type* __table_, position __pos_)
+		: table(__table_), pos(__pos_) {}
 
-	template<class Key,
-		class T,
-		class Hash,
-		class KeyEqual,
-		class Allocator>
-	inline bool operator!=(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& rhs)
-	{ return (lhs.ref != rhs.ref) || (lhs.offset != rhs.offset); }
-	// End Compare Normal Iterators
+	const storage_type* table;
+	position pos;
+};
 
 // Normal Iterator Member Functions
 	template<class Key,
 		class T,
 		class Hash,
 		class KeyEqual,
-		class Allocator>
-	typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::operator=(
-			const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& other)
-	{
-		this->ref = other.ref;
-		this->offset = other.offset;
-		return *this;
-	}
-
-	template<class Key,
-		class T,
-		class Hash,
-		class KeyEqual,
-		class Allocator>
-	typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator& hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::operator++()
+		class Allocator,
+		class Policy>
+	typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::operator++()
 	{
-		(this->offset)++;
+		table->advance(pos);
 		return *this;
 	}
 
@@ -368,11 +486,12 @@ private:
 		class T,
 		class Hash,
 		class KeyEqual,
-		class Allocator>
-	typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::operator++(int)
+		class Allocator,
+		class Policy>
+	typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::operator++(int)
 	{
 		iterator tmp(*this);
-		(this->offset)++;
+		table->advance(pos);
 		return tmp;
 	}
 
@@ -380,20 +499,22 @@ private:
 		class T,
 		class Hash,
 		class KeyEqual,
-		class Allocator>
-	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::pointer hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::operator->() const
+		class Allocator,
+		class Policy>
+	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::pointer hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::operator->() const
 	{
-		return (ref + (offset * sizeof(hashTable<Key, T, Hash, KeyEqual, Allocator>::hashNode*) ) );
+		return storage_reference::address(table->value(pos));
 	}
 
 	template<class Key,
 		class T,
 		class Hash,
 		class KeyEqual,
-		class Allocator>
-	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::reference hashTable<Key, T, Hash, KeyEqual, Allocator>::iterator::operator*() const
+		class Allocator,
+		class Policy>
+	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::reference hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator::operator*() const
 	{
-		return *(ref + offset);
+		return table->value(pos);
 	}
 	// End Normal Iterator Member Functions
 // End Iterator
@@ -403,231 +524,1539 @@ template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-class hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator
-	: std::iterator<std::forward_iterator_tag, typename hashTable<Key, T, Hash, KeyEqual, Allocator>::hashNode const*>
+	class Allocator,
+	class Policy>
+class hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator
 {
+	friend class hashTable;
 public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename hashTable::value_type value_type;
+	typedef typename hashTable::difference_type difference_type;
+	typedef typename storage_reference::const_pointer pointer;
+	typedef typename storage_reference::const_reference reference;
+
 	constexpr const_iterator()
-		: const_iterator(nullptr, 0) {}
-	constexpr const_iterator(hashNode const** __ref_)
-		: const_iterator(__ref_, 0) {}
-	explicit constexpr const_iterator(hashNode const** __ref_, hashTable::size_type __offset_)
-		: ref(__ref_), offset(__offset_) {}
+		: table(nullptr), pos() {}
+	const_iterator(const iterator& other)
+		: table(other.table), pos(other.pos) {}
 
-	const_iterator& operator=(const iterator& other);
-	const_iterator& operator=(const const_iterator& other);
+	const_iterator& operator++();
+	const_iterator operator++(int);
 
-	iterator& operator++();
-	iterator operator++(int);
-	
 	pointer operator->() const;
 	reference operator*() const;
 
-	~const_iterator();
-
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator==(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_iterator& rhs);
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator!=(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_iterator& rhs);
+	friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+		{ return lhs.pos == rhs.pos; }
+	friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
+		{ return lhs.pos != rhs.pos; }
 
 private:
-	hashNode const** ref;
-	hashTable::size_type offset;
+	const_iterator(const storage_type* __table_, position __pos_)
+		: table(__table_), pos(__pos_) {}
+
+	const storage_type* table;
+	position pos;
 };
 
-// Const Iterator Comparators
+// Const Iterator Member Functions
+	template<class Key,
+		class T,
+		class Hash,
+		class KeyEqual,
+		class Allocator,
+		class Policy>
+	typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::operator++()
+	{
+		table->advance(pos);
+		return *this;
+	}
+
+	template<class Key,
+		class T,
+		class Hash,
+		class KeyEqual,
+		class Allocator,
+		class Policy>
+	typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::operator++(int)
+	{
+		const_iterator tmp(*this);
+		table->advance(pos);
+		return tmp;
+	}
+
 	template<class Key,
 		class T,
 		class Hash,
 		class KeyEqual,
-		class Allocator>
-	inline bool operator==(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& rhs)
+		class Allocator,
+		class Policy>
+	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::pointer hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::operator->() const
 	{
-		return (lhs.ref == rhs.ref) && (lhs.offset == rhs.offset);
+		return storage_reference::address(reference(table->value(pos)));
 	}
-	// End Const Iterator Comparators
 
+	template<class Key,
+		class T,
+		class Hash,
+		class KeyEqual,
+		class Allocator,
+		class Policy>
+	inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::reference hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator::operator*() const
+	{
+		return table->value(pos);
+	}
+	// End Const Iterator Member Functions
 // End Const Iterator
 
+// Local Iterator
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator==(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& rhs)
-{ return (lhs.ref == rhs.ref); }
+	class Allocator,
+	class Policy>
+class hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::local_iterator
+{
+	friend class hashTable;
+	friend class const_local_iterator;
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename hashTable::value_type value_type;
+	typedef typename hashTable::difference_type difference_type;
+	typedef typename storage_reference::pointer pointer;
+	typedef typename storage_reference::reference reference;
+
+	constexpr local_iterator()
+		: table(nullptr), pos() {}
+
+	local_iterator& operator++()
+		{ table->local_advance(pos); return *this; }
+	local_iterator operator++(int)
+		{ local_iterator tmp(*this); table->local_advance(pos); return tmp; }
+
+	pointer operator->() const
+		{ return storage_reference::address(table->local_value(pos)); }
+	reference operator*() const
+		{ return table->local_value(pos); }
+
+	friend bool operator==(const local_iterator& lhs, const local_iterator& rhs)
+		{ return lhs.pos == rhs.pos; }
+	friend bool operator!=(const local_iterator& lhs, const local_iterator& rhs)
+		{ return lhs.pos != rhs.pos; }
 
+private:
+	local_iterator(const storage_type* __table_, local_position __pos_)
+		: table(__table_), pos(__pos_) {}
+
+	const storage_type* table;
+	local_position pos;
+}; // End Local Iterator
+
+// Const Local Iterator
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator!=(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator& rhs)
-{ return (lhs.ref != rhs.ref); }
+	class Allocator,
+	class Policy>
+class hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_local_iterator
+{
+	friend class hashTable;
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename hashTable::value_type value_type;
+	typedef typename hashTable::difference_type difference_type;
+	typedef typename storage_reference::const_pointer pointer;
+	typedef typename storage_reference::const_reference reference;
+
+	constexpr const_local_iterator()
+		: table(nullptr), pos() {}
+	const_local_iterator(const local_iterator& other)
+		: table(other.table), pos(other.pos) {}
+
+	const_local_iterator& operator++()
+		{ table->local_advance(pos); return *this; }
+	const_local_iterator operator++(int)
+		{ const_local_iterator tmp(*this); table->local_advance(pos); return tmp; }
+
+	pointer operator->() const
+		{ return storage_reference::address(reference(table->local_value(pos))); }
+	reference operator*() const
+		{ return table->local_value(pos); }
+
+	friend bool operator==(const const_local_iterator& lhs, const const_local_iterator& rhs)
+		{ return lhs.pos == rhs.pos; }
+	friend bool operator!=(const const_local_iterator& lhs, const const_local_iterator& rhs)
+		{ return lhs.pos != rhs.pos; }
 
-// Local Iterator
+private:
+	const_local_iterator(const storage_type* __table_, local_position __pos_)
+		: table(__table_), pos(__pos_) {}
+
+	const storage_type* table;
+	local_position pos;
+}; // End Const Local Iterator
+
+// what insert(node_type&&) did: on a duplicate key the node comes back
+// unchanged and position is the element that blocked it
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-class hashTable<Key, T, Hash, KeyEqual, Allocator>::local_iterator
-	: std::iterator<std::forward_iterator_tag, hashTable<Key, T, Hash, KeyEqual, Allocator>::value_type>
+	class Allocator,
+	class Policy>
+struct hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_return_type
 {
-public:
-	local_iterator()
-		: local_iterator(nullptr) {}
-	explicit constexpr local_iterator(hashNode* __ref_)
-		: ref(__ref_) {}
-
-	local_iterator& operator=(const local_iterator& other);
+	iterator position;
+	bool inserted;
+	node_type node;
+}; // End Insert Return Type
 
-	local_iterator& operator++();
-	local_iterator operator++(int);
+// CONSTRUCTORS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(
+		size_type bucket_count,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __storage(bucket_count, hash, equal, alloc)
+{
 
-	pointer operator->() const;
-	reference operator*() const;
+}
 
-	~local_iterator();
-
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator==(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::local_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::local_iterator& rhs);
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator!=(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::local_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::local_iterator& rhs);
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(const Allocator& alloc)
+	: __storage(DEFAULT_BUCKET_SIZE, Hash(), KeyEqual(), alloc)
+{
 
-private:
-	hashNode* ref;
-}; // End Local Iterator
+}
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator==(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::local_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::local_iterator& rhs)
-{ return (lhs.ref == rhs.ref); }
+	class Allocator,
+	class Policy>
+
+	template<class InputIt>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(InputIt first, InputIt last,
+		size_type bucket_count,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __storage(bucket_count, hash, equal, alloc)
+{
+	insert(first, last);
+}
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator!=(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::local_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::local_iterator& rhs)
-{ return (lhs.ref != rhs.ref); }
+	class Allocator,
+	class Policy>
+	template<class InputIt>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(InputIt first, InputIt last,
+		thread_count threads,
+		size_type bucket_count,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __storage(bucket_count, hash, equal, alloc)
+{
+	insert(first, last, threads);
+}
 
-// Const Local Iterator
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-class hashTable<Key, T, Hash, KeyEqual, Allocator>::const_local_iterator
-	: std::iterator<std::forward_iterator_tag, hashTable<Key, T, Hash, KeyEqual, Allocator>::value_type const>
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(const hashTable& other)
+	: __storage(other.__storage)
 {
-public:
-	const_local_iterator()
-		: const_local_iterator(nullptr) {}
-	explicit constexpr const_local_iterator(hashNode const* __ref_)
-		: ref(__ref_) {}
-
-	const_local_iterator& operator=(const local_iterator& other);
-	const_local_iterator& operator=(const const_local_iterator& other);
 
-	const_local_iterator& operator++();
-	const_local_iterator operator++(int);
+}
 
-	pointer operator->() const;
-	reference operator*() const;
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(const hashTable& other, const Allocator& alloc)
+	: __storage(other.__storage, alloc)
+{
 
-	~const_local_iterator();
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator==(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_local_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_local_iterator& rhs);
-	template<class UKey,
-		class UT,
-		class UHash,
-		class UKeyEqual,
-		class UAllocator>
-	friend bool operator!=(const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_local_iterator& lhs, const typename hashTable<UKey, UT, UHash, UKeyEqual, UAllocator>::const_local_iterator& rhs);
-	
-private:
-	hashNode const* ref;
-}; // End Const Local Iterator
+}
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator==(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_local_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_local_iterator& rhs)
-{ return (lhs.ref == rhs.ref); }
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(hashTable&& other)
+	: __storage(std::move(other.__storage))
+{
+
+}
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-inline bool operator!=(const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_local_iterator& lhs, const typename hashTable<Key, T, Hash, KeyEqual, Allocator>::const_local_iterator& rhs)
-{ return (lhs.ref != rhs.ref); }
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(hashTable&& other, const Allocator& alloc)
+	: __storage(std::move(other.__storage), alloc)
+{
+
+}
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-hashTable<Key, T, Hash, KeyEqual, Allocator>::hashTable(
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hashTable(std::initializer_list<value_type> init,
 		size_type bucket_count,
 		const Hash& hash,
 		const KeyEqual& equal,
 		const Allocator& alloc)
+	: __storage(bucket_count, hash, equal, alloc)
 {
-
+	insert(init.begin(), init.end());
 }
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
-hashTable<Key, T, Hash, KeyEqual, Allocator>::hashTable(const Allocator& alloc)
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::operator=(const hashTable& other)
 {
-
+	if(this != &other)
+	{
+		hashTable tmp(other);
+		__storage.swap(tmp.__storage);
+	}
+	return *this;
 }
 
 template<class Key,
 	class T,
 	class Hash,
 	class KeyEqual,
-	class Allocator>
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::operator=(hashTable&& other)
+{
+	if(this != &other)
+	{
+		hashTable tmp(std::move(other));
+		__storage.swap(tmp.__storage);
+	}
+	return *this;
+}
 
-	template<class InputIt>
-hashTable<Key, T, Hash, KeyEqual, Allocator>::hashTable(InputIt first, InputIt last,
-		size_type bucket_count,
-		const Hash& hash,
-		const KeyEqual& equal,
-		const Allocator& alloc)
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::~hashTable()
 {
 
 }
 
-#endif // __HASH__TABLE_H_
\ No newline at end of file
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::allocator_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::get_allocator() const
+{ return __storage.get_allocator(); }
+
+// ITERATORS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::begin() noexcept
+{ return iterator(&__storage, __storage.first()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::begin() const noexcept
+{ return const_iterator(&__storage, __storage.first()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::cbegin() const noexcept
+{ return begin(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::end()
+{ return iterator(&__storage, __storage.last()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::end() const
+{ return const_iterator(&__storage, __storage.last()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::cend() const
+{ return end(); }
+
+// CAPACITY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline bool hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::empty() const noexcept
+{ return __storage.size() == 0; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size() const noexcept
+{ return __storage.size(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::max_size() const noexcept
+{ return __storage.max_size(); }
+
+// MODIFIERS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::clear() noexcept
+{ __storage.clear(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(const value_type& value)
+{ return emplace(value); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class P, class>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(P&& value)
+{ return emplace(::forward<P>(value)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(const_iterator, const value_type& value)
+{ return emplace(value).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class P, class>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(const_iterator, P&& value)
+{ return emplace(::forward<P>(value)).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class InputIt>
+void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(InputIt first, InputIt last)
+{
+	for(; first != last; ++first)
+		emplace(*first);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class InputIt>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(InputIt first, InputIt last, thread_count threads)
+{ __insert_parallel(first, last, threads, typename std::iterator_traits<InputIt>::iterator_category()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class InputIt>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__insert_parallel(InputIt first, InputIt last, thread_count, std::input_iterator_tag)
+{ insert(first, last); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__insert_parallel(ForwardIt first, ForwardIt last, thread_count threads, std::forward_iterator_tag)
+{ __storage.insert_parallel(first, last, threads); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(std::initializer_list<value_type> ilist)
+{ insert(ilist.begin(), ilist.end()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class M>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_or_assign(const key_type& k, M&& obj)
+{
+	pair<position, bool> result = __storage.try_emplace(k, ::forward<M>(obj));
+	if(!result.second)
+		__storage.value(result.first).second = ::forward<M>(obj);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class M>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_or_assign(key_type&& k, M&& obj)
+{
+	pair<position, bool> result = __storage.try_emplace(std::move(k), ::forward<M>(obj));
+	if(!result.second)
+		__storage.value(result.first).second = ::forward<M>(obj);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class M>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_or_assign(const_iterator, const key_type& k, M&& obj)
+{ return insert_or_assign(k, ::forward<M>(obj)).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class M>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_or_assign(const_iterator, key_type&& k, M&& obj)
+{ return insert_or_assign(std::move(k), ::forward<M>(obj)).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::emplace(Args&&... args)
+{
+	pair<position, bool> result = __storage.emplace(::forward<Args>(args)...);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::emplace(const_iterator, Args&&... args)
+{ return emplace(::forward<Args>(args)...).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::try_emplace(const key_type& k, Args&&... args)
+{
+	pair<position, bool> result = __storage.try_emplace(k, ::forward<Args>(args)...);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::try_emplace(key_type&& k, Args&&... args)
+{
+	pair<position, bool> result = __storage.try_emplace(std::move(k), ::forward<Args>(args)...);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::try_emplace(const_iterator, const key_type& k, Args&&... args)
+{ return try_emplace(k, ::forward<Args>(args)...).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class... Args>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::try_emplace(const_iterator, key_type&& k, Args&&... args)
+{ return try_emplace(std::move(k), ::forward<Args>(args)...).first; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::erase(const_iterator pos)
+{ return __make_iterator(__storage.erase(pos.pos)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::erase(const_iterator first, const_iterator last)
+{ return __make_iterator(__storage.erase_range(first.pos, last.pos)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::erase(const key_type& key)
+{ return __storage.erase_key(key); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::node_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::extract(const_iterator pos)
+{ return node_type(__storage.extract(pos.pos), get_allocator()); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::node_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::extract(const key_type& key)
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		return node_type();
+	return node_type(__storage.extract(p), get_allocator());
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_return_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(node_type&& node)
+{
+	if(node.empty())
+		return insert_return_type{ end(), false, node_type() };
+	pair<position, bool> result = __storage.insert_node(node.__node, !node.__rekeyed);
+	if(result.second)
+	{
+		node.__release();
+		return insert_return_type{ __make_iterator(result.first), true, node_type() };
+	}
+	return insert_return_type{ __make_iterator(result.first), false, std::move(node) };
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(const_iterator, node_type&& node)
+{ return insert(std::move(node)).position; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge(hashTable& source)
+{ __storage.merge(source.__storage); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge(hashTable&& source)
+{ __storage.merge(source.__storage); }
+
+// AGGREGATION
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class Init, class Update>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::upsert(const key_type& k, Init init, Update update)
+{ return __upsert(k, init, update); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class Init, class Update>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::upsert(key_type&& k, Init init, Update update)
+{ return __upsert(std::move(k), init, update); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class V, class Combine>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge_value(const key_type& k, V&& value, Combine combine)
+{ return __merge_value(k, ::forward<V>(value), combine); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class V, class Combine>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge_value(key_type&& k, V&& value, Combine combine)
+{ return __merge_value(std::move(k), ::forward<V>(value), combine); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class Combine>
+void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge_values(ForwardIt first, ForwardIt last, Combine combine)
+{
+	__for_each_hashed(first, last, [](const auto& row) -> const auto& { return row.first; },
+		[&](const auto& row, size_type hash)
+		{
+			pair<position, bool> result = __storage.try_emplace_hashed(hash, row.first, row.second);
+			if(!result.second)
+				combine(__storage.value(result.first).second, row.second);
+		});
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class Combine>
+void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge_values(ForwardIt first, ForwardIt last, Combine combine, thread_count threads)
+{
+	size_type n = static_cast<size_type>(std::distance(first, last));
+	unsigned count = threads.for_size(n);
+	if(count == 1)
+	{
+		merge_values(first, last, combine);
+		return;
+	}
+	std::vector<hashTable> parts;
+	parts.reserve(count);
+	for(unsigned t = 0; t < count; ++t)
+		parts.emplace_back(size_type(DEFAULT_BUCKET_SIZE), hash_function(), key_eq(), get_allocator());
+	__run_threads(count, [&](unsigned t)
+	{
+		ForwardIt begin = std::next(first, __chunk_begin(n, t, count));
+		ForwardIt end = std::next(first, __chunk_begin(n, t + 1, count));
+		parts[t].merge_values(begin, end, combine);
+	});
+	// keys are const inside parts, so they are copied, only when new here;
+	// the mapped values are the parts' own to give up
+	for(unsigned t = 0; t < count; ++t)
+		for(auto&& row : parts[t])
+			__merge_value(row.first, std::move(row.second), combine);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class Init, class Update>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__upsert(K&& k, Init& init, Update& update)
+{
+	pair<position, bool> result = __storage.try_emplace(::forward<K>(k), __lazyValue<Init>{ init });
+	if(!result.second)
+		update(__storage.value(result.first).second);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+// try_emplace only builds from value when it inserts, so a present key
+// still has value to combine
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class V, class Combine>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__merge_value(K&& k, V&& value, Combine& combine)
+{
+	pair<position, bool> result = __storage.try_emplace(::forward<K>(k), ::forward<V>(value));
+	if(!result.second)
+		combine(__storage.value(result.first).second, ::forward<V>(value));
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::swap(hashTable& other)
+{ __storage.swap(other.__storage); }
+
+// LOOKUP
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::at(const key_type& key)
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		throw std::out_of_range("hashTable::at");
+	return __storage.value(p).second;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+const typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::at(const key_type& key) const
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		throw std::out_of_range("hashTable::at");
+	return __storage.value(p).second;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::operator[](const key_type& key)
+{ return __storage.value(__storage.try_emplace(key).first).second; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::operator[](key_type&& key)
+{ return __storage.value(__storage.try_emplace(std::move(key)).first).second; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::count(const key_type& key) const
+{ return __storage.find(key) != __storage.last() ? 1 : 0; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline bool hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::contains(const key_type& key) const
+{ return __storage.find(key) != __storage.last(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find(const key_type& key)
+{ return iterator(&__storage, __storage.find(key)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find(const key_type& key) const
+{ return const_iterator(&__storage, __storage.find(key)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::equal_range(const key_type& key)
+{
+	iterator first = find(key);
+	iterator last = first;
+	if(last != end())
+		++last;
+	return pair<iterator, iterator>(first, last);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator, typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::equal_range(const key_type& key) const
+{
+	const_iterator first = find(key);
+	const_iterator last = first;
+	if(last != end())
+		++last;
+	return pair<const_iterator, const_iterator>(first, last);
+}
+
+// TRANSPARENT LOOKUP
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class, class... Args>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::try_emplace(K&& k, Args&&... args)
+{
+	pair<position, bool> result = __storage.try_emplace(::forward<K>(k), ::forward<Args>(args)...);
+	return pair<iterator, bool>(__make_iterator(result.first), result.second);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class, class Init, class Update>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::upsert(K&& k, Init init, Update update)
+{ return __upsert(::forward<K>(k), init, update); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class, class V, class Combine>
+inline pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, bool> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::merge_value(K&& k, V&& value, Combine combine)
+{ return __merge_value(::forward<K>(k), ::forward<V>(value), combine); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::erase(const K& key)
+{ return __storage.erase_key(key); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::node_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::extract(const K& key)
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		return node_type();
+	return node_type(__storage.extract(p), get_allocator());
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::at(const K& key)
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		throw std::out_of_range("hashTable::at");
+	return __storage.value(p).second;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+const typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::mapped_type& hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::at(const K& key) const
+{
+	position p = __storage.find(key);
+	if(p == __storage.last())
+		throw std::out_of_range("hashTable::at");
+	return __storage.value(p).second;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::count(const K& key) const
+{ return __storage.find(key) != __storage.last() ? 1 : 0; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+inline bool hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::contains(const K& key) const
+{ return __storage.find(key) != __storage.last(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find(const K& key)
+{ return iterator(&__storage, __storage.find(key)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find(const K& key) const
+{ return const_iterator(&__storage, __storage.find(key)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator, typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::iterator> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::equal_range(const K& key)
+{
+	iterator first = find(key);
+	iterator last = first;
+	if(last != end())
+		++last;
+	return pair<iterator, iterator>(first, last);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class K, class>
+pair<typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator, typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator> hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::equal_range(const K& key) const
+{
+	const_iterator first = find(key);
+	const_iterator last = first;
+	if(last != end())
+		++last;
+	return pair<const_iterator, const_iterator>(first, last);
+}
+
+// BATCH LOOKUP
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class OutputIt>
+OutputIt hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find_batch(ForwardIt first, ForwardIt last, OutputIt out)
+{
+	__for_each_hashed(first, last, [](const auto& key) -> const auto& { return key; },
+		[&](const auto& key, size_type hash)
+		{ *out++ = __make_iterator(__storage.find_hashed(key, hash)); });
+	return out;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class OutputIt>
+OutputIt hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::find_batch(ForwardIt first, ForwardIt last, OutputIt out) const
+{
+	__for_each_hashed(first, last, [](const auto& key) -> const auto& { return key; },
+		[&](const auto& key, size_type hash)
+		{ *out++ = const_iterator(&__storage, __storage.find_hashed(key, hash)); });
+	return out;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt>
+typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::count_batch(ForwardIt first, ForwardIt last) const
+{
+	size_type found = 0;
+	__for_each_hashed(first, last, [](const auto& key) -> const auto& { return key; },
+		[&](const auto& key, size_type hash)
+		{ found += __storage.find_hashed(key, hash) != __storage.last(); });
+	return found;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt>
+void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_batch(ForwardIt first, ForwardIt last)
+{
+	// only grow, and at least double, so a run of small batches rehashes
+	// no more often than single inserts would
+	size_type count = size() + static_cast<size_type>(std::distance(first, last));
+	size_type fits = static_cast<size_type>(bucket_count() * max_load_factor());
+	if(count > fits)
+		reserve(std::max(count, fits * 2));
+	__for_each_hashed(first, last, [](const value_type& value) -> const key_type& { return value.first; },
+		[&](const value_type& value, size_type hash)
+		{ __storage.try_emplace_hashed(hash, value.first, value.second); });
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class KeyOf, class F>
+void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__for_each_hashed(ForwardIt first, ForwardIt last, KeyOf key_of, F f) const
+{
+	size_type hashes[BATCH_SIZE];
+	while(first != last)
+	{
+		ForwardIt batch = first;
+		size_type n = 0;
+		for(; n < BATCH_SIZE && first != last; ++n, ++first)
+		{
+			hashes[n] = __storage.hash_key(key_of(*first));
+			__storage.prefetch(hashes[n]);
+		}
+		for(size_type i = 0; i < n; ++i, ++batch)
+			f(*batch, hashes[i]);
+	}
+}
+
+// BUCKET INTERFACE
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::begin(size_type n)
+{ return local_iterator(&__storage, __storage.local_first(n)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::begin(size_type n) const
+{ return const_local_iterator(&__storage, __storage.local_first(n)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::cbegin(size_type n) const
+{ return begin(n); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::end(size_type n)
+{ return local_iterator(&__storage, __storage.local_last(n)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::end(size_type n) const
+{ return const_local_iterator(&__storage, __storage.local_last(n)); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_local_iterator hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::cend(size_type n) const
+{ return end(n); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::bucket_count() const
+{ return __storage.bucket_count(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::max_bucket_count() const
+{ return __storage.max_bucket_count(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::bucket_size(size_type n) const
+{ return __storage.bucket_size(n); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::bucket(const key_type& key) const
+{ return __storage.bucket(key); }
+
+// HASH POLICY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline float hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::load_factor() const
+{ return __storage.bucket_count() ? float(__storage.size()) / __storage.bucket_count() : 0.0f; }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline float hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::max_load_factor() const
+{ return __storage.max_load_factor(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::max_load_factor(float ml)
+{ __storage.max_load_factor(ml); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline float hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::min_load_factor() const
+{ return __storage.min_load_factor(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::min_load_factor(float ml)
+{ __storage.min_load_factor(ml); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::rehash(size_type count)
+{ __storage.rehash(count); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::reserve(size_type count)
+{ __storage.rehash(static_cast<size_type>(std::ceil(count / __storage.max_load_factor()))); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::rehash(size_type count, thread_count threads)
+{ __storage.rehash(count, threads); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::reserve(size_type count, thread_count threads)
+{ __storage.rehash(static_cast<size_type>(std::ceil(count / __storage.max_load_factor())), threads); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::shrink_to_fit()
+{ __storage.rehash(0); }
+
+// STATISTICS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline hashTableStats hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::stats() const
+{ return __storage.stats(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline hashTableMemory hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::memory_usage() const
+{ return __storage.memory_usage(); }
+
+// OBSERVERS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hasher hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::hash_function() const
+{ return __storage.hash_function(); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::key_equal hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::key_eq() const
+{ return __storage.key_eq(); }
+
+// COMPARE
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+bool operator==(const hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& lhs, const hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& rhs)
+{
+	if(lhs.size() != rhs.size())
+		return false;
+	for(typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator it = lhs.begin(); it != lhs.end(); ++it)
+	{
+		typename hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::const_iterator match = rhs.find(it->first);
+		if(match == rhs.end() || !(match->second == it->second))
+			return false;
+	}
+	return true;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline bool operator!=(const hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& lhs, const hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& rhs)
+{ return !(lhs == rhs); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline void swap(hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& lhs, hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>& rhs)
+{ lhs.swap(rhs); }
+
+// a hashTable that holds up to N elements without allocating
+template<class Key,
+	class T,
+	std::size_t N = 8,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >,
+	class Large = chained_policy>
+using small_hashTable = hashTable<Key, T, Hash, KeyEqual, Allocator, small_policy<N, Large> >;
+
+#endif // __HASH__TABLE_H_
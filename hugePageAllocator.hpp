@@ -0,0 +1,195 @@
+#ifndef __HUGE_PAGE_ALLOCATOR_H__
+#define __HUGE_PAGE_ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// How huge_page_allocator places its large blocks.
+//
+// Blocks of at least threshold bytes are mapped on their own, rounded up
+// to whole 2 MB pages. TRANSPARENT_PAGES aligns them to 2 MB and asks for
+// transparent huge pages with madvise; EXPLICIT_PAGES first tries the
+// reserved hugetlbfs pool and falls back to transparent pages when it is
+// empty. A NUMA mode other than NUMA_LOCAL binds the block to, or
+// interleaves it over, the nodes set in node_mask. Each step is a request:
+// when the kernel refuses one, the block simply stays on normal pages or
+// on the local node.
+struct huge_page_options
+{
+	enum { HUGE_PAGE_SIZE = 2 << 20, DEFAULT_THRESHOLD = 1 << 20, MAX_NODES = sizeof(unsigned long) * 8 };
+
+	enum page_mode { TRANSPARENT_PAGES, EXPLICIT_PAGES };
+	enum numa_mode { NUMA_LOCAL, NUMA_BIND, NUMA_INTERLEAVE };
+
+	huge_page_options()
+		: pages(TRANSPARENT_PAGES), numa(NUMA_LOCAL), node_mask(0), threshold(DEFAULT_THRESHOLD) {}
+
+	static huge_page_options explicit_pages()
+	{
+		huge_page_options o;
+		o.pages = EXPLICIT_PAGES;
+		return o;
+	}
+	// node_mask has one bit per node, so only nodes below MAX_NODES can be named
+	static huge_page_options bind(unsigned node)
+	{
+		if(node >= MAX_NODES)
+			throw std::invalid_argument("huge_page_options::bind: node out of range");
+		huge_page_options o;
+		o.numa = NUMA_BIND;
+		o.node_mask = 1ul << node;
+		return o;
+	}
+	static huge_page_options interleave(unsigned long node_mask)
+	{
+		huge_page_options o;
+		o.numa = NUMA_INTERLEAVE;
+		o.node_mask = node_mask;
+		return o;
+	}
+
+	friend bool operator==(const huge_page_options& lhs, const huge_page_options& rhs)
+	{
+		return lhs.pages == rhs.pages && lhs.numa == rhs.numa
+			&& lhs.node_mask == rhs.node_mask && lhs.threshold == rhs.threshold;
+	}
+	friend bool operator!=(const huge_page_options& lhs, const huge_page_options& rhs)
+		{ return !(lhs == rhs); }
+
+	page_mode pages;
+	numa_mode numa;
+	unsigned long node_mask;	// nodes 0 .. MAX_NODES - 1 as bits
+	std::size_t threshold;		// smaller blocks come from operator new
+};
+
+inline std::size_t __huge_round(std::size_t bytes)
+{
+	std::size_t page = huge_page_options::HUGE_PAGE_SIZE;
+	return (bytes + page - 1) / page * page;
+}
+
+#ifdef __linux__
+// mbind without libnuma; failure leaves the default policy in place
+inline void __numa_place(void* p, std::size_t bytes, const huge_page_options& o)
+{
+#ifdef SYS_mbind
+	enum { MPOL_BIND_ = 2, MPOL_INTERLEAVE_ = 3 };
+	unsigned long mask = o.node_mask;
+	int mode = o.numa == huge_page_options::NUMA_BIND ? MPOL_BIND_ : MPOL_INTERLEAVE_;
+	// maxnode counts one past the last bit the kernel should read
+	syscall(SYS_mbind, p, bytes, mode, &mask, sizeof(mask) * 8 + 1, 0);
+#else
+	(void)p;
+	(void)bytes;
+	(void)o;
+#endif
+}
+
+// map bytes, a multiple of HUGE_PAGE_SIZE, as options ask; nullptr when
+// the memory itself cannot be had
+inline void* __map_huge(std::size_t bytes, const huge_page_options& o)
+{
+	std::size_t page = huge_page_options::HUGE_PAGE_SIZE;
+	void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	if(o.pages == huge_page_options::EXPLICIT_PAGES)
+		p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if(p == MAP_FAILED)
+	{
+		// transparent huge pages only back 2 MB aligned ranges, so map one
+		// page more than needed and trim both ends
+		char* raw = static_cast<char*>(mmap(nullptr, bytes + page, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if(raw == MAP_FAILED)
+			return nullptr;
+		char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(raw) + page - 1) / page * page);
+		if(aligned != raw)
+			munmap(raw, aligned - raw);
+		if(aligned + bytes != raw + bytes + page)
+			munmap(aligned + bytes, raw + page - aligned);
+		p = aligned;
+#ifdef MADV_HUGEPAGE
+		madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	}
+	// before the first touch, which is when pages get placed
+	if(o.numa != huge_page_options::NUMA_LOCAL)
+		__numa_place(p, bytes, o);
+	return p;
+}
+
+inline void __unmap_huge(void* p, std::size_t bytes) { munmap(p, bytes); }
+#else
+// no mmap: large blocks are ordinary allocations
+inline void* __map_huge(std::size_t bytes, const huge_page_options&)
+	{ return ::operator new(bytes, std::nothrow); }
+inline void __unmap_huge(void* p, std::size_t) { ::operator delete(p); }
+#endif
+
+// An allocator that puts large blocks, such as bucket and slot arrays or
+// the slabs of huge_page_chained_policy, on 2 MB pages, so that random
+// lookups in a table of hundreds of millions of elements stop missing the
+// TLB as well as the cache. Small blocks, such as the nodes of an unpooled
+// chained table, go to operator new. Whether a block was mapped follows
+// from its size, so allocators only compare equal with equal options.
+template<class T>
+class huge_page_allocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	huge_page_allocator() noexcept {}
+	explicit huge_page_allocator(const huge_page_options& options) noexcept
+		: __options(options) {}
+	template<class U>
+	huge_page_allocator(const huge_page_allocator<U>& other) noexcept
+		: __options(other.options()) {}
+
+	T* allocate(std::size_t n)
+	{
+		if(n > static_cast<std::size_t>(-1) / sizeof(T))
+			throw std::bad_alloc();
+		std::size_t bytes = n * sizeof(T);
+		if(bytes < __options.threshold)
+			return static_cast<T*>(::operator new(bytes));
+		void* p = __map_huge(__huge_round(bytes), __options);
+		if(!p)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept
+	{
+		std::size_t bytes = n * sizeof(T);
+		if(bytes < __options.threshold)
+			::operator delete(p);
+		else
+			__unmap_huge(p, __huge_round(bytes));
+	}
+
+	const huge_page_options& options() const noexcept { return __options; }
+
+	template<class U>
+	friend bool operator==(const huge_page_allocator& lhs, const huge_page_allocator<U>& rhs) noexcept
+		{ return lhs.options() == rhs.options(); }
+	template<class U>
+	friend bool operator!=(const huge_page_allocator& lhs, const huge_page_allocator<U>& rhs) noexcept
+		{ return !(lhs == rhs); }
+
+private:
+	huge_page_options __options;
+};
+
+#endif // __HUGE_PAGE_ALLOCATOR_H__
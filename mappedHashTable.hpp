@@ -0,0 +1,355 @@
+#ifndef __MAPPED_HASH_TABLE_H__
+#define __MAPPED_HASH_TABLE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+
+// SNAPSHOT IMAGES
+// save_snapshot() writes the elements of a table with trivially copyable
+// keys and values to a file that mapped_hashTable maps back and queries
+// in place: no parsing, no per element allocation.
+//
+// The image is a header followed by one control byte per slot and then
+// the slots, all addressed by offsets from the start of the file, so it
+// works wherever it is mapped. Slots use open addressing with linear
+// probing; a full slot's control byte holds 7 bits of its mixed hash and
+// an empty one is IMAGE_EMPTY. Probing is byte by byte rather than by
+// ctrlGroup so that the layout does not depend on the SIMD width of the
+// build. Hash must give the same result in the writing and the reading
+// process, which std::hash does for integers.
+struct snapshotHeader
+{
+	enum { VERSION = 1 };
+
+	char magic[8];				// "HTSNAP\0\0"
+	std::uint32_t version;
+	std::uint32_t byte_order;	// 0x01020304 as written
+	std::uint64_t key_size;
+	std::uint64_t mapped_size;
+	std::uint64_t slot_size;
+	std::uint64_t size;			// elements
+	std::uint64_t capacity;		// slots, a power of two
+	std::uint64_t ctrl_offset;
+	std::uint64_t slots_offset;
+	std::uint64_t image_size;
+	std::uint64_t checksum;		// of everything after the header
+};
+
+enum : unsigned char { IMAGE_EMPTY = 0x80 };
+
+// checksum of an image payload, eight bytes at a time
+inline std::uint64_t __image_checksum(const unsigned char* p, std::size_t n)
+{
+	std::uint64_t h = 14695981039346656037ULL;
+	std::size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, p + i, 8);
+		h = (h ^ word) * 1099511628211ULL;
+		h ^= h >> 29;
+	}
+	for(; i < n; ++i)
+		h = (h ^ p[i]) * 1099511628211ULL;
+	return h;
+}
+
+inline std::uint64_t __image_align(std::uint64_t offset, std::uint64_t alignment)
+{ return (offset + alignment - 1) / alignment * alignment; }
+
+// an open file descriptor that closes itself
+class __imageFile
+{
+public:
+	explicit __imageFile(int fd) : fd(fd) {}
+	~__imageFile() { if(fd >= 0) ::close(fd); }
+	__imageFile(const __imageFile&) = delete;
+	__imageFile& operator=(const __imageFile&) = delete;
+
+	int fd;
+};
+
+// a writable mapping of an image that unmaps itself
+class __imageMapping
+{
+public:
+	__imageMapping(void* addr, std::size_t size) : addr(addr), size(size) {}
+	~__imageMapping() { if(addr != MAP_FAILED) ::munmap(addr, size); }
+	__imageMapping(const __imageMapping&) = delete;
+	__imageMapping& operator=(const __imageMapping&) = delete;
+
+	void* addr;
+	std::size_t size;
+};
+
+// a temporary image path that is removed unless kept
+class __imagePending
+{
+public:
+	explicit __imagePending(const std::string& path) : path(path), kept(false) {}
+	~__imagePending() { if(!kept) ::unlink(path.c_str()); }
+	__imagePending(const __imagePending&) = delete;
+	__imagePending& operator=(const __imagePending&) = delete;
+
+	void keep() { kept = true; }
+
+	std::string path;
+	bool kept;
+};
+
+// write table to path as a snapshot image; the file appears under its
+// name only once it is complete
+template<class Table>
+void save_snapshot(const Table& table, const char* path)
+{
+	typedef typename Table::key_type key_type;
+	typedef typename Table::mapped_type mapped_type;
+	typedef pair<key_type, mapped_type> slot_type;
+	static_assert(std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<mapped_type>::value,
+		"snapshots hold trivially copyable keys and values only");
+
+	std::uint64_t capacity = __next_pow2(table.size() + table.size() / 7 + 1);
+	if(capacity < 8)
+		capacity = 8;
+
+	snapshotHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "HTSNAP\0\0", 8);
+	header.version = snapshotHeader::VERSION;
+	header.byte_order = 0x01020304;
+	header.key_size = sizeof(key_type);
+	header.mapped_size = sizeof(mapped_type);
+	header.slot_size = sizeof(slot_type);
+	header.size = table.size();
+	header.capacity = capacity;
+	header.ctrl_offset = sizeof(snapshotHeader);
+	header.slots_offset = __image_align(header.ctrl_offset + capacity, 64);
+	header.image_size = header.slots_offset + capacity * sizeof(slot_type);
+
+	// a fresh temporary per call, so saves to the same path never share one
+	std::string tmp = std::string(path) + ".XXXXXX";
+	__imageFile file(::mkstemp(&tmp[0]));
+	if(file.fd < 0)
+		throw std::runtime_error(std::string("save_snapshot: cannot create a temporary for ") + path);
+	__imagePending pending(tmp);
+	if(::fchmod(file.fd, 0644) != 0)
+		throw std::runtime_error("save_snapshot: cannot set the mode of " + tmp);
+	if(::ftruncate(file.fd, static_cast<off_t>(header.image_size)) != 0)
+		throw std::runtime_error("save_snapshot: cannot size " + tmp);
+	__imageMapping map(::mmap(nullptr, header.image_size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0),
+		header.image_size);
+	if(map.addr == MAP_FAILED)
+		throw std::runtime_error("save_snapshot: cannot map " + tmp);
+
+	unsigned char* image = static_cast<unsigned char*>(map.addr);
+	unsigned char* ctrl = image + header.ctrl_offset;
+	slot_type* slots = reinterpret_cast<slot_type*>(image + header.slots_offset);
+	std::memset(ctrl, IMAGE_EMPTY, capacity);
+
+	typename Table::hasher hash = table.hash_function();
+	std::uint64_t mask = capacity - 1;
+	for(typename Table::const_iterator it = table.begin(); it != table.end(); ++it)
+	{
+		std::size_t h = __mix_hash(hash(it->first));
+		std::uint64_t i = (h >> 7) & mask;
+		while(ctrl[i] != IMAGE_EMPTY)
+			i = (i + 1) & mask;
+		ctrl[i] = static_cast<unsigned char>(h & 0x7f);
+		std::memcpy(static_cast<void*>(slots + i), &it->first, sizeof(key_type));
+		std::memcpy(static_cast<void*>(&slots[i].second), &it->second, sizeof(mapped_type));
+	}
+
+	header.checksum = __image_checksum(image + sizeof(snapshotHeader), header.image_size - sizeof(snapshotHeader));
+	std::memcpy(image, &header, sizeof(header));
+	if(::msync(map.addr, header.image_size, MS_SYNC) != 0 || ::rename(tmp.c_str(), path) != 0)
+		throw std::runtime_error(std::string("save_snapshot: cannot write ") + path);
+	pending.keep();
+}
+
+// Read only view of a snapshot image. Opening maps the file and checks
+// the header (and, unless told not to, the checksum, which reads the
+// whole file); after that lookups touch only the pages they probe.
+template<class Key,
+	class T,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>
+> class mapped_hashTable
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+		"snapshots hold trivially copyable keys and values only");
+
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename mapped_hashTable::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator() : table(nullptr), slot(0) {}
+
+		reference operator*() const { return table->__slots[slot]; }
+		pointer operator->() const { return table->__slots + slot; }
+
+		const_iterator& operator++() { ++slot; table->__skip_empty(slot); return *this; }
+		const_iterator operator++(int) { const_iterator tmp(*this); ++(*this); return tmp; }
+
+		friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs.slot == rhs.slot; }
+		friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return lhs.slot != rhs.slot; }
+
+	private:
+		friend class mapped_hashTable;
+		const_iterator(const mapped_hashTable* table, size_type slot) : table(table), slot(slot) {}
+
+		const mapped_hashTable* table;
+		size_type slot;
+	};
+	typedef const_iterator iterator;
+
+	explicit mapped_hashTable(const char* path, bool verify_checksum = true,
+		const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+		: __hash(hash), __equal(equal), __image(nullptr), __image_size(0)
+	{
+		__imageFile file(::open(path, O_RDONLY));
+		if(file.fd < 0)
+			throw std::runtime_error(std::string("mapped_hashTable: cannot open ") + path);
+		struct stat st;
+		if(::fstat(file.fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < sizeof(snapshotHeader))
+			throw std::runtime_error(std::string("mapped_hashTable: not a snapshot: ") + path);
+		__image_size = static_cast<size_type>(st.st_size);
+		void* map = ::mmap(nullptr, __image_size, PROT_READ, MAP_SHARED, file.fd, 0);
+		if(map == MAP_FAILED)
+			throw std::runtime_error(std::string("mapped_hashTable: cannot map ") + path);
+		__image = static_cast<const unsigned char*>(map);
+		try
+		{
+			__check(path, verify_checksum);
+		}
+		catch(...)
+		{
+			::munmap(map, __image_size);
+			throw;
+		}
+	}
+
+	mapped_hashTable(mapped_hashTable&& other) noexcept
+		: __hash(std::move(other.__hash)), __equal(std::move(other.__equal)),
+		  __image(other.__image), __image_size(other.__image_size), __header(other.__header),
+		  __ctrl(other.__ctrl), __slots(other.__slots)
+	{
+		other.__image = nullptr;
+		other.__image_size = 0;
+	}
+	mapped_hashTable(const mapped_hashTable&) = delete;
+	mapped_hashTable& operator=(const mapped_hashTable&) = delete;
+
+	~mapped_hashTable()
+	{
+		if(__image)
+			::munmap(const_cast<unsigned char*>(__image), __image_size);
+	}
+
+	const_iterator begin() const
+	{
+		size_type slot = 0;
+		__skip_empty(slot);
+		return const_iterator(this, slot);
+	}
+	const_iterator end() const { return const_iterator(this, __header.capacity); }
+
+	bool empty() const noexcept { return __header.size == 0; }
+	size_type size() const noexcept { return __header.size; }
+	size_type bucket_count() const noexcept { return __header.capacity; }
+
+	const_iterator find(const key_type& key) const
+	{
+		std::size_t h = __mix_hash(__hash(key));
+		unsigned char h2 = static_cast<unsigned char>(h & 0x7f);
+		size_type mask = __header.capacity - 1;
+		// bounded, an unverified image may hold no empty slot
+		for(size_type n = 0, i = (h >> 7) & mask; n < __header.capacity; ++n, i = (i + 1) & mask)
+		{
+			if(__ctrl[i] == h2 && __equal(__slots[i].first, key))
+				return const_iterator(this, i);
+			if(__ctrl[i] == IMAGE_EMPTY)
+				return end();
+		}
+		return end();
+	}
+	size_type count(const key_type& key) const { return find(key) != end() ? 1 : 0; }
+	bool contains(const key_type& key) const { return find(key) != end(); }
+	const mapped_type& at(const key_type& key) const
+	{
+		const_iterator it = find(key);
+		if(it == end())
+			throw std::out_of_range("mapped_hashTable::at");
+		return it->second;
+	}
+
+	hasher hash_function() const { return __hash; }
+	key_equal key_eq() const { return __equal; }
+
+private:
+	void __check(const char* path, bool verify_checksum)
+	{
+		std::memcpy(&__header, __image, sizeof(__header));
+		const snapshotHeader& h = __header;
+		if(std::memcmp(h.magic, "HTSNAP\0\0", 8) != 0 || h.version != snapshotHeader::VERSION
+			|| h.byte_order != 0x01020304)
+			throw std::runtime_error(std::string("mapped_hashTable: not a version 1 snapshot: ") + path);
+		if(h.key_size != sizeof(key_type) || h.mapped_size != sizeof(mapped_type) || h.slot_size != sizeof(value_type))
+			throw std::runtime_error(std::string("mapped_hashTable: key or value type differs from the snapshot: ") + path);
+		// subtract and divide rather than add and multiply: every field is
+		// untrusted, and a wrapped sum could pass for the file's size
+		if(h.capacity == 0 || (h.capacity & (h.capacity - 1)) != 0 || h.size >= h.capacity
+			|| h.image_size != __image_size || h.slots_offset > h.image_size
+			|| h.ctrl_offset < sizeof(snapshotHeader) || h.ctrl_offset > h.slots_offset
+			|| h.capacity > h.slots_offset - h.ctrl_offset || h.slots_offset % alignof(value_type) != 0
+			|| (h.image_size - h.slots_offset) % sizeof(value_type) != 0
+			|| (h.image_size - h.slots_offset) / sizeof(value_type) != h.capacity)
+			throw std::runtime_error(std::string("mapped_hashTable: corrupt snapshot header: ") + path);
+		if(verify_checksum
+			&& __image_checksum(__image + sizeof(snapshotHeader), __image_size - sizeof(snapshotHeader)) != h.checksum)
+			throw std::runtime_error(std::string("mapped_hashTable: snapshot checksum mismatch: ") + path);
+		__ctrl = __image + h.ctrl_offset;
+		__slots = reinterpret_cast<const value_type*>(__image + h.slots_offset);
+	}
+
+	void __skip_empty(size_type& slot) const
+	{
+		while(slot < __header.capacity && __ctrl[slot] == IMAGE_EMPTY)
+			++slot;
+	}
+
+	hasher __hash;
+	key_equal __equal;
+	const unsigned char* __image;
+	size_type __image_size;
+	snapshotHeader __header;
+	const unsigned char* __ctrl;
+	const value_type* __slots;
+};
+
+#endif // __MAPPED_HASH_TABLE_H__
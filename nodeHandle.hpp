@@ -0,0 +1,176 @@
+#ifndef __NODE_HANDLE_H__
+#define __NODE_HANDLE_H__
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "utility.hpp"
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class hashTable;
+
+// the node a layout without nodes of its own hands out from extract(): the
+// element moved into a heap allocation of its own. store_hash lets it
+// stand in for a chained node wherever one is built from a value.
+template<class Value>
+struct __valueNode
+{
+	template<class... Args>
+	explicit __valueNode(Args&&... args)
+		: value(::forward<Args>(args)...) {}
+
+	void store_hash(std::size_t) {}
+
+	Value value;
+};
+
+// allocate a Node from the Allocator rebound to it and build it from args
+template<class Node, class Allocator, class... Args>
+Node* __make_node(const Allocator& alloc, Args&&... args)
+{
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+	node_allocator a(alloc);
+	Node* n = node_traits::allocate(a, 1);
+	try
+	{
+		node_traits::construct(a, n, ::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		node_traits::deallocate(a, n, 1);
+		throw;
+	}
+	return n;
+}
+
+template<class Node, class Allocator>
+void __drop_node(const Allocator& alloc, Node* n)
+{
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+	node_allocator a(alloc);
+	node_traits::destroy(a, n);
+	node_traits::deallocate(a, n, 1);
+}
+
+// extract, insert_node and merge for layouts that keep their elements in
+// place: the element goes into a __valueNode and back out again. Keys are
+// const there, so they are copied and only the mapped values move; the
+// key is also still intact when erase hashes it to find its slot.
+template<class Storage>
+typename Storage::node* __extract_value(Storage& storage, typename Storage::position p)
+{
+	auto&& v = storage.value(p);
+	typename Storage::node* n = __make_node<typename Storage::node>(storage.get_allocator(),
+		v.first, std::move(v.second));
+	storage.erase(p);
+	return n;
+}
+
+template<class Storage>
+pair<typename Storage::position, bool> __insert_value(Storage& storage, typename Storage::node* n)
+{
+	pair<typename Storage::position, bool> result = storage.try_emplace(
+		n->value.first, std::move(n->value.second));
+	if(result.second)
+		__drop_node(storage.get_allocator(), n);
+	return result;
+}
+
+template<class Storage>
+void __merge_values(Storage& storage, Storage& source)
+{
+	if(&storage == &source)
+		return;
+	for(typename Storage::position p = source.first(); p != source.last(); )
+	{
+		auto&& v = source.value(p);
+		if(storage.try_emplace(v.first, std::move(v.second)).second)
+			p = source.erase(p);
+		else
+			source.advance(p);
+	}
+}
+
+// The node_type of a hashTable: sole owner of one element taken out of a
+// table by extract(), which insert() can link into a table with an equal
+// allocator. With chained storage the node itself changes tables, so
+// nothing is allocated or copied, and its cached hash is reused unless the
+// key was reached through a non-const handle. The other layouts build a
+// node of their own from the element, and the element again from it.
+template<class Key, class T, class Node, class Allocator>
+class node_handle
+{
+	typedef std::allocator_traits<Allocator> alloc_traits;
+
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef Allocator allocator_type;
+
+	node_handle() noexcept : __node(nullptr), __rekeyed(false) {}
+	node_handle(node_handle&& other) noexcept
+		: __node(other.__node), __alloc(std::move(other.__alloc)), __rekeyed(other.__rekeyed)
+	{ other.__node = nullptr; }
+
+	node_handle& operator=(node_handle&& other)
+	{
+		if(this == &other)
+			return *this;
+		__destroy();
+		if(alloc_traits::propagate_on_container_move_assignment::value || !__node)
+			__alloc = std::move(other.__alloc);
+		__node = other.__node;
+		__rekeyed = other.__rekeyed;
+		other.__node = nullptr;
+		return *this;
+	}
+
+	~node_handle() { __destroy(); }
+
+	bool empty() const noexcept { return __node == nullptr; }
+	explicit operator bool() const noexcept { return __node != nullptr; }
+	allocator_type get_allocator() const { return __alloc; }
+
+	// the key may be changed before the node is inserted again
+	key_type& key() { __rekeyed = true; return const_cast<key_type&>(__node->value.first); }
+	const key_type& key() const { return __node->value.first; }
+	mapped_type& mapped() const { return __node->value.second; }
+
+	void swap(node_handle& other) noexcept
+	{
+		using std::swap;
+		if(alloc_traits::propagate_on_container_swap::value || !__node || !other.__node)
+			swap(__alloc, other.__alloc);
+		swap(__node, other.__node);
+		swap(__rekeyed, other.__rekeyed);
+	}
+	friend void swap(node_handle& lhs, node_handle& rhs) noexcept { lhs.swap(rhs); }
+
+private:
+	template<class, class, class, class, class, class> friend class hashTable;
+
+	node_handle(Node* n, const allocator_type& alloc)
+		: __node(n), __alloc(alloc), __rekeyed(false) {}
+
+	Node* __release()
+	{
+		Node* n = __node;
+		__node = nullptr;
+		return n;
+	}
+
+	void __destroy()
+	{
+		if(__node)
+			__drop_node(__alloc, __node);
+		__node = nullptr;
+	}
+
+	Node* __node;
+	allocator_type __alloc;
+	bool __rekeyed;		// key() may have changed the key, so its hash is stale
+};
+
+#endif // __NODE_HANDLE_H__
@@ -0,0 +1,135 @@
+#ifndef __NODE_POOL_H__
+#define __NODE_POOL_H__
+
+#include <cstddef>
+#include <memory>
+
+// Slab allocator for fixed size nodes.
+//
+// Nodes are carved out of slabs obtained from the node allocator, starting
+// at MIN_SLAB nodes and doubling up to MAX_SLAB (MaxSlab, 4096 by default). Freed nodes go on an
+// intrusive free list and are handed out again before a slab is touched.
+// release() gives every slab back at once, so a table that drops all of its
+// elements never frees them one by one. The allocator is passed in on each
+// call so that the owning table keeps control of propagation.
+template<class Node, class NodeAllocator, std::size_t MaxSlab = 4096>
+class nodePool
+{
+	typedef std::allocator_traits<NodeAllocator> node_traits;
+
+public:
+	typedef std::size_t size_type;
+
+	enum { MIN_SLAB = 16, MAX_SLAB = MaxSlab };
+
+	nodePool() noexcept : __slabs(nullptr), __free(nullptr), __cursor(nullptr), __end(nullptr), __next_slab(MIN_SLAB) {}
+	nodePool(const nodePool&) = delete;
+	nodePool& operator=(const nodePool&) = delete;
+	nodePool(nodePool&& other) noexcept
+		: __slabs(other.__slabs), __free(other.__free), __cursor(other.__cursor), __end(other.__end),
+		  __next_slab(other.__next_slab)
+	{
+		other.__slabs = nullptr;
+		other.__free = nullptr;
+		other.__cursor = other.__end = nullptr;
+		other.__next_slab = MIN_SLAB;
+	}
+
+	// the owner must call release() before the pool goes away
+	~nodePool() {}
+
+	// uninitialised storage for one node
+	Node* allocate(NodeAllocator& alloc)
+	{
+		if(__free)
+		{
+			Node* n = reinterpret_cast<Node*>(__free);
+			__free = __free->next;
+			return n;
+		}
+		if(__cursor == __end)
+			__grow(alloc);
+		return __cursor++;
+	}
+
+	// return storage whose node has already been destroyed
+	void deallocate(Node* n) noexcept
+	{
+		freeNode* f = reinterpret_cast<freeNode*>(n);
+		f->next = __free;
+		__free = f;
+	}
+
+	// give every slab back to alloc; outstanding nodes must already be destroyed
+	void release(NodeAllocator& alloc) noexcept
+	{
+		while(__slabs)
+		{
+			slabHeader* next = __slabs->next;
+			node_traits::deallocate(alloc, reinterpret_cast<Node*>(__slabs), __slabs->count);
+			__slabs = next;
+		}
+		__free = nullptr;
+		__cursor = __end = nullptr;
+		__next_slab = MIN_SLAB;
+	}
+
+	// nodes held in slabs, headers and unused nodes included, and slabs
+	size_type allocated_nodes() const noexcept
+	{
+		size_type count = 0;
+		for(slabHeader* slab = __slabs; slab; slab = slab->next)
+			count += slab->count;
+		return count;
+	}
+	size_type slab_count() const noexcept
+	{
+		size_type count = 0;
+		for(slabHeader* slab = __slabs; slab; slab = slab->next)
+			++count;
+		return count;
+	}
+
+	void swap(nodePool& other) noexcept
+	{
+		using std::swap;
+		swap(__slabs, other.__slabs);
+		swap(__free, other.__free);
+		swap(__cursor, other.__cursor);
+		swap(__end, other.__end);
+		swap(__next_slab, other.__next_slab);
+	}
+
+private:
+	struct freeNode { freeNode* next; };
+	struct slabHeader
+	{
+		slabHeader* next;
+		size_type count;	// nodes allocated for the slab, header included
+	};
+
+	// nodes at the front of each slab given over to its header
+	enum { HEADER_NODES = (sizeof(slabHeader) + sizeof(Node) - 1) / sizeof(Node) };
+
+	void __grow(NodeAllocator& alloc)
+	{
+		size_type count = HEADER_NODES + __next_slab;
+		Node* slab = node_traits::allocate(alloc, count);
+		slabHeader* header = reinterpret_cast<slabHeader*>(slab);
+		header->next = __slabs;
+		header->count = count;
+		__slabs = header;
+		__cursor = slab + HEADER_NODES;
+		__end = slab + count;
+		if(__next_slab < MAX_SLAB)
+			__next_slab *= 2;
+	}
+
+	slabHeader* __slabs;
+	freeNode* __free;
+	Node* __cursor;		// next never used node in the newest slab
+	Node* __end;
+	size_type __next_slab;
+};
+
+#endif // __NODE_POOL_H__
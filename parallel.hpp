@@ -0,0 +1,99 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// How many threads a parallel build or rehash may use; 0 asks for one per
+// core. Work is only split while every thread gets at least
+// PARALLEL_GRAIN elements, so small tables stay on the calling thread.
+//
+// Parallel operations allocate and construct from several threads at
+// once, so the allocator must allow that (std::allocator does).
+struct thread_count
+{
+	enum { PARALLEL_GRAIN = 1 << 14 };
+
+	explicit thread_count(unsigned n = 0)
+		: threads(n ? n : std::thread::hardware_concurrency())
+	{
+		if(threads == 0)
+			threads = 1;
+	}
+
+	// threads worth using for n elements
+	unsigned for_size(std::size_t n) const
+	{
+		std::size_t useful = n / PARALLEL_GRAIN;
+		return useful == 0 ? 1 : useful < threads ? static_cast<unsigned>(useful) : threads;
+	}
+
+	unsigned threads;
+};
+
+// call f(0) .. f(threads - 1), f(0) on the calling thread and the rest on
+// threads of their own; once all have returned, rethrow the first
+// exception any of them threw
+template<class F>
+void __run_threads(unsigned threads, F f)
+{
+	std::vector<std::exception_ptr> errors(threads);
+	auto run = [&f, &errors](unsigned t)
+	{
+		try
+		{
+			f(t);
+		}
+		catch(...)
+		{
+			errors[t] = std::current_exception();
+		}
+	};
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for(unsigned t = 1; t < threads; ++t)
+	{
+		// a thread that cannot be started runs its share here instead
+		try
+		{
+			workers.emplace_back(run, t);
+		}
+		catch(...)
+		{
+			run(t);
+		}
+	}
+	run(0);
+	for(std::size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+	for(unsigned t = 0; t < threads; ++t)
+		if(errors[t])
+			std::rethrow_exception(errors[t]);
+}
+
+// the part of [0, n) that thread t of threads handles: n * t / threads,
+// split so that nothing overflows
+inline std::size_t __chunk_begin(std::size_t n, unsigned t, unsigned threads)
+{ return n / threads * t + n % threads * t / threads; }
+
+// hash(*it) for every element of [first, first + n), computed in parallel;
+// for layouts whose placement cannot be split, hashing is the part that
+// still scales
+template<class ForwardIt, class HashOf>
+std::vector<std::size_t> __hash_parallel(ForwardIt first, std::size_t n, unsigned threads, HashOf hash_of)
+{
+	std::vector<std::size_t> hashes(n);
+	__run_threads(threads, [&](unsigned t)
+	{
+		std::size_t i = __chunk_begin(n, t, threads), end = __chunk_begin(n, t + 1, threads);
+		ForwardIt it = std::next(first, i);
+		for(; i < end; ++i, ++it)
+			hashes[i] = hash_of(*it);
+	});
+	return hashes;
+}
+
+#endif // __PARALLEL_H__
@@ -0,0 +1,496 @@
+#ifndef __PARTITIONED_HASH_TABLE_H__
+#define __PARTITIONED_HASH_TABLE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "hashTable.hpp"
+
+// A table for batch jobs that build more than fits in memory, probed
+// partition by partition as in a grace hash join.
+//
+// Keys are split by the top bits of their hash into a power of two number
+// of partitions, each a hashTable of its own. While the resident
+// partitions outgrow the memory budget, the largest is spilled: its
+// elements are written to a file in the spill directory as packed key and
+// mapped records, and its table is freed. Later inserts into a spilled
+// partition are appended to its file, so building never reads anything
+// back. partition(p) brings a partition back, spilling others first if it
+// would not fit, and probe() and probe_sorted() look up a stream of keys so
+// that each partition is loaded once.
+//
+// Records are raw bytes, so keys and mapped values must be trivially
+// copyable; Hash only has to agree with itself within the process. The
+// budget covers the memory_usage() of the resident tables, but not the
+// write buffers of spilled partitions, SPILL_BUFFER bytes at most each. A
+// partition larger than the budget on its own is still loaded when asked
+// for, so pick enough partitions that none is. Errors reading or writing
+// spill files throw std::runtime_error.
+template<class Key,
+	class T = Key,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >,
+	class Policy = chained_policy
+> class partitioned_hashTable
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+		"spilled partitions hold trivially copyable keys and values only");
+
+public:
+	enum { DEFAULT_PARTITIONS = 64, SPILL_BUFFER = 1 << 16 };
+
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+	typedef hashTable<Key, T, Hash, KeyEqual, Allocator, Policy> table_type;
+
+	// partitions is rounded up to a power of two
+	partitioned_hashTable(size_type memory_budget,
+		const std::string& spill_directory,
+		size_type partitions = DEFAULT_PARTITIONS,
+		const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(),
+		const Allocator& alloc = Allocator());
+
+	partitioned_hashTable(const partitioned_hashTable&) = delete;
+	partitioned_hashTable& operator=(const partitioned_hashTable&) = delete;
+
+	~partitioned_hashTable();
+
+	// BUILDING
+	// the last value inserted for a key wins, resident or spilled
+	template<class M>
+	void insert_or_assign(const key_type& k, M&& obj);
+	// insert_or_assign for each pair of a range
+	template<class InputIt>
+	void insert(InputIt first, InputIt last);
+
+	// PROBING
+	// the table of partition p, loaded if it was spilled; it stays valid
+	// until the next call that may load or spill a partition
+	const table_type& partition(size_type p);
+	// f(key, mapped) for every key of a range, mapped being nullptr for a
+	// missing key. Keys are grouped by partition first, so calls come
+	// partition by partition rather than in input order.
+	template<class ForwardIt, class F>
+	void probe(ForwardIt first, ForwardIt last, F f);
+	// the same in input order for a stream already ordered by partition_of,
+	// such as the output of an earlier pass; any order works, but each
+	// change of partition may load one
+	template<class InputIt, class F>
+	void probe_sorted(InputIt first, InputIt last, F f);
+	// f(p, table) for every partition in turn
+	template<class F>
+	void for_each_partition(F f);
+
+	// PARTITIONS
+	size_type partition_count() const noexcept { return __parts.size(); }
+	size_type partition_of(const key_type& key) const;
+	bool resident(size_type p) const { return __parts[p].table != nullptr; }
+	// memory_usage().total() of the resident tables
+	size_type resident_bytes() const noexcept { return __resident_bytes; }
+	size_type memory_budget() const noexcept { return __budget; }
+	// how many times a partition was written out
+	size_type spills() const noexcept { return __spills; }
+
+private:
+	enum { RECORD_SIZE = sizeof(key_type) + sizeof(mapped_type) };
+
+	struct partitionState
+	{
+		partitionState() : bytes(0), records(0) {}
+
+		std::unique_ptr<table_type> table;	// null while spilled
+		size_type bytes;					// memory usage of a resident table
+		size_type records;					// in the file and buffer while spilled
+		std::vector<unsigned char> buffer;	// records not yet appended to the file
+	};
+
+	static size_type __estimate(const table_type& table, size_type records);
+	std::string __path(size_type p) const;
+	void __resize_resident(partitionState& part);
+	void __enforce_budget(size_type need, size_type keep);
+	void __spill(size_type p);
+	void __flush(size_type p);
+	void __load(size_type p);
+	void __append(partitionState& part, const key_type& k, const mapped_type& obj);
+
+	hasher __hash;
+	key_equal __equal;
+	allocator_type __alloc;
+	std::vector<partitionState> __parts;
+	unsigned __shift;				// hash bits below the partition number
+	size_type __budget;
+	size_type __resident_bytes;
+	size_type __spills;
+	std::string __prefix;			// spill file path up to the partition number
+};
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::partitioned_hashTable(
+		size_type memory_budget,
+		const std::string& spill_directory,
+		size_type partitions,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __hash(hash), __equal(equal), __alloc(alloc), __parts(__next_pow2(partitions ? partitions : 1)),
+	  __shift(64), __budget(memory_budget), __resident_bytes(0), __spills(0)
+{
+	for(size_type n = __parts.size(); n > 1; n >>= 1)
+		--__shift;
+	// distinct per table, so several tables and processes can share a directory
+	char tag[32];
+	std::snprintf(tag, sizeof(tag), "%016llx", static_cast<unsigned long long>(__random_seed()));
+	__prefix = spill_directory + "/hashTable-" + tag + "-";
+	for(size_type p = 0; p < __parts.size(); ++p)
+	{
+		__parts[p].table.reset(new table_type(0, __hash, __equal, __alloc));
+		__resize_resident(__parts[p]);
+	}
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::~partitioned_hashTable()
+{
+	for(size_type p = 0; p < __parts.size(); ++p)
+		if(!__parts[p].table)
+			std::remove(__path(p).c_str());
+}
+
+// BUILDING
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class M>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert_or_assign(const key_type& k, M&& obj)
+{
+	size_type p = partition_of(k);
+	partitionState& part = __parts[p];
+	if(!part.table)
+	{
+		const mapped_type value(::forward<M>(obj));
+		__append(part, k, value);
+		if(part.buffer.size() >= SPILL_BUFFER)
+			__flush(p);
+		return;
+	}
+	size_type buckets = part.table->bucket_count();
+	if(part.table->insert_or_assign(k, ::forward<M>(obj)).second
+		|| part.table->bucket_count() != buckets)
+	{
+		__resize_resident(part);
+		if(__resident_bytes > __budget)
+			__enforce_budget(0, __parts.size());
+	}
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class InputIt>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::insert(InputIt first, InputIt last)
+{
+	for(; first != last; ++first)
+		insert_or_assign((*first).first, (*first).second);
+}
+
+// PROBING
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+const typename partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::table_type& partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::partition(size_type p)
+{
+	if(!__parts[p].table)
+		__load(p);
+	return *__parts[p].table;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class ForwardIt, class F>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::probe(ForwardIt first, ForwardIt last, F f)
+{
+	std::vector<std::vector<ForwardIt> > groups(__parts.size());
+	for(; first != last; ++first)
+		groups[partition_of(*first)].push_back(first);
+	for(size_type p = 0; p < groups.size(); ++p)
+	{
+		if(groups[p].empty())
+			continue;
+		const table_type& table = partition(p);
+		for(size_type i = 0; i < groups[p].size(); ++i)
+		{
+			typename table_type::const_iterator it = table.find(*groups[p][i]);
+			f(*groups[p][i], it != table.end() ? &it->second : nullptr);
+		}
+		std::vector<ForwardIt>().swap(groups[p]);
+	}
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class InputIt, class F>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::probe_sorted(InputIt first, InputIt last, F f)
+{
+	const table_type* table = nullptr;
+	size_type current = __parts.size();
+	for(; first != last; ++first)
+	{
+		const key_type& key = *first;
+		size_type p = partition_of(key);
+		if(p != current)
+		{
+			table = &partition(p);
+			current = p;
+		}
+		typename table_type::const_iterator it = table->find(key);
+		f(key, it != table->end() ? &it->second : nullptr);
+	}
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+	template<class F>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::for_each_partition(F f)
+{
+	for(size_type p = 0; p < __parts.size(); ++p)
+		f(p, partition(p));
+}
+
+// PARTITIONS
+// the top bits of a multiplicative hash, which the partitions' own tables
+// do not use to place keys
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline typename partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::partition_of(const key_type& key) const
+{
+	if(__shift == 64)
+		return 0;
+	return static_cast<size_type>((std::uint64_t(__hash(key)) * 0x9e3779b97f4a7c15ULL) >> __shift);
+}
+
+// INTERNALS
+// the bytes a table reserved for records elements will hold once they are
+// in, counted as memory_usage() counts them: what it already allocated
+// and, for storage that allocates per element, a node each with the value,
+// two links and a block's allocator overhead
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+typename partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__estimate(const table_type& table, size_type records)
+{
+	hashTableMemory m = table.memory_usage();
+	if(m.elements == 0)
+		m.add_elements(records * (sizeof(value_type) + 2 * sizeof(void*)), records);
+	return m.total();
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+inline std::string partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__path(size_type p) const
+{ return __prefix + std::to_string(p) + ".part"; }
+
+// bring part's share of __resident_bytes up to date
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__resize_resident(partitionState& part)
+{
+	size_type bytes = part.table->memory_usage().total();
+	__resident_bytes = __resident_bytes - part.bytes + bytes;
+	part.bytes = bytes;
+}
+
+// spill the largest resident partitions other than keep until need more
+// bytes fit within the budget, or nothing else is left to spill
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__enforce_budget(size_type need, size_type keep)
+{
+	while(__resident_bytes + need > __budget)
+	{
+		size_type largest = __parts.size();
+		for(size_type p = 0; p < __parts.size(); ++p)
+			if(p != keep && __parts[p].table && __parts[p].table->size() != 0
+				&& (largest == __parts.size() || __parts[p].bytes > __parts[largest].bytes))
+				largest = p;
+		if(largest == __parts.size())
+			return;
+		__spill(largest);
+	}
+}
+
+// write a resident partition to its file and free its table
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__spill(size_type p)
+{
+	partitionState& part = __parts[p];
+	part.records = 0;
+	for(typename table_type::const_iterator it = part.table->begin(); it != part.table->end(); ++it)
+	{
+		__append(part, it->first, it->second);
+		if(part.buffer.size() >= SPILL_BUFFER)
+			__flush(p);
+	}
+	__flush(p);
+	__resident_bytes -= part.bytes;
+	part.bytes = 0;
+	part.table.reset();
+	++__spills;
+}
+
+// append the buffered records of p to its file
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__flush(size_type p)
+{
+	partitionState& part = __parts[p];
+	if(part.buffer.empty())
+		return;
+	std::string path = __path(p);
+	std::FILE* file = std::fopen(path.c_str(), "ab");
+	if(!file)
+		throw std::runtime_error("partitioned_hashTable: cannot open " + path);
+	bool written = std::fwrite(part.buffer.data(), 1, part.buffer.size(), file) == part.buffer.size();
+	if(std::fclose(file) != 0 || !written)
+		throw std::runtime_error("partitioned_hashTable: cannot write " + path);
+	part.buffer.clear();
+}
+
+// read a spilled partition back, replaying its records in order, and
+// delete its file
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__load(size_type p)
+{
+	partitionState& part = __parts[p];
+	std::unique_ptr<table_type> table(new table_type(0, __hash, __equal, __alloc));
+	table->reserve(part.records);
+	__enforce_budget(__estimate(*table, part.records), p);
+	key_type key;
+	mapped_type mapped;
+	std::string path = __path(p);
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if(file)
+	{
+		std::vector<unsigned char> chunk(SPILL_BUFFER / RECORD_SIZE * RECORD_SIZE + RECORD_SIZE);
+		size_type got;
+		while((got = std::fread(chunk.data(), 1, chunk.size(), file)) != 0)
+			for(size_type at = 0; at + RECORD_SIZE <= got; at += RECORD_SIZE)
+			{
+				std::memcpy(static_cast<void*>(&key), chunk.data() + at, sizeof(key_type));
+				std::memcpy(static_cast<void*>(&mapped), chunk.data() + at + sizeof(key_type), sizeof(mapped_type));
+				table->insert_or_assign(key, mapped);
+			}
+		bool failed = std::ferror(file) != 0;
+		std::fclose(file);
+		if(failed)
+			throw std::runtime_error("partitioned_hashTable: cannot read " + path);
+	}
+	for(size_type at = 0; at < part.buffer.size(); at += RECORD_SIZE)
+	{
+		std::memcpy(static_cast<void*>(&key), part.buffer.data() + at, sizeof(key_type));
+		std::memcpy(static_cast<void*>(&mapped), part.buffer.data() + at + sizeof(key_type), sizeof(mapped_type));
+		table->insert_or_assign(key, mapped);
+	}
+
+	std::remove(path.c_str());
+	std::vector<unsigned char>().swap(part.buffer);
+	part.records = 0;
+	part.table = std::move(table);
+	__resize_resident(part);
+	// records overwritten in the file make the estimate high, an allocator
+	// rounding up makes it low; the others make up any difference
+	__enforce_budget(0, p);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator,
+	class Policy>
+void partitioned_hashTable<Key, T, Hash, KeyEqual, Allocator, Policy>::__append(partitionState& part, const key_type& k, const mapped_type& obj)
+{
+	size_type at = part.buffer.size();
+	part.buffer.resize(at + RECORD_SIZE);
+	std::memcpy(part.buffer.data() + at, static_cast<const void*>(&k), sizeof(key_type));
+	std::memcpy(part.buffer.data() + at + sizeof(key_type), static_cast<const void*>(&obj), sizeof(mapped_type));
+	++part.records;
+}
+
+#endif // __PARTITIONED_HASH_TABLE_H__
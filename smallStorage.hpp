@@ -0,0 +1,538 @@
+#ifndef __SMALL_STORAGE_H__
+#define __SMALL_STORAGE_H__
+
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "nodeHandle.hpp"
+#include "parallel.hpp"
+#include "tableStats.hpp"
+
+// Small table storage: up to Policy::INLINE_CAPACITY elements live in an
+// array inside the table itself and are found by comparing keys one after
+// another, without hashing and without touching the heap. The insert that
+// would overflow the array moves everything into the storage of
+// Policy::large_policy, which serves the table from then on, until clear()
+// brings it back to the array.
+//
+// While inline the table reports a single bucket holding every element.
+// Erasing an inline element shifts the later ones down, so it invalidates
+// iterators to them, as well as to the erased one; insertion order is
+// kept.
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class smallStorage
+{
+	typedef typename Policy::large_policy large_policy;
+	typedef typename large_policy::template storage<Key, T, Hash, KeyEqual, Allocator, large_policy> large_type;
+
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	enum { CAPACITY = Policy::INLINE_CAPACITY };
+	static_assert(CAPACITY > 0, "smallStorage: INLINE_CAPACITY must be positive");
+
+	// an inline index, or NONE with a position of the large storage; the
+	// large position of an inline one is its last(), so that the end
+	// compares equal in either mode
+	struct position
+	{
+		size_type index;
+		typename large_type::position large;
+
+		bool operator==(const position& other) const { return index == other.index && large == other.large; }
+		bool operator!=(const position& other) const { return !(*this == other); }
+	};
+	struct local_position
+	{
+		size_type index;
+		typename large_type::local_position large;
+
+		bool operator==(const local_position& other) const { return index == other.index && large == other.large; }
+		bool operator!=(const local_position& other) const { return !(*this == other); }
+	};
+
+	typedef typename large_type::node node;
+
+	static const size_type NONE = size_type(-1);
+
+	// the bucket count only sizes the large storage, which is left empty
+	// until it is needed
+	smallStorage(size_type, const hasher& hash,
+		const key_equal& equal, const allocator_type& alloc)
+		: __large(0, hash, equal, alloc), __equal(equal), __value_alloc(alloc), __count(0), __spilled(false) {}
+
+	smallStorage(const smallStorage& other)
+		: smallStorage(other, value_traits::select_on_container_copy_construction(other.__value_alloc)) {}
+	smallStorage(const smallStorage& other, const allocator_type& alloc)
+		: __large(other.__large, alloc), __equal(other.__equal), __value_alloc(alloc),
+		  __count(0), __spilled(other.__spilled)
+	{
+		try
+		{
+			for(; __count < other.__count; ++__count)
+				value_traits::construct(__value_alloc, __slot(__count), *other.__slot(__count));
+		}
+		catch(...)
+		{
+			__destroy_inline();
+			throw;
+		}
+	}
+
+	smallStorage(smallStorage&& other)
+		noexcept(std::is_nothrow_move_constructible<value_type>::value)
+		: __large(std::move(other.__large)), __equal(std::move(other.__equal)),
+		  __value_alloc(std::move(other.__value_alloc)), __count(0), __spilled(other.__spilled)
+	{
+		__take(other);
+	}
+	smallStorage(smallStorage&& other, const allocator_type& alloc)
+		: __large(std::move(other.__large), alloc), __equal(other.__equal), __value_alloc(alloc),
+		  __count(0), __spilled(other.__spilled)
+	{
+		__take(other);
+	}
+
+	~smallStorage() { __destroy_inline(); }
+
+	void swap(smallStorage& other)
+		noexcept(std::is_nothrow_move_constructible<value_type>::value)
+	{
+		using std::swap;
+		__large.swap(other.__large);
+		swap(__equal, other.__equal);
+		if(value_traits::propagate_on_container_swap::value)
+			swap(__value_alloc, other.__value_alloc);
+		size_type common = __count < other.__count ? __count : other.__count;
+		for(size_type i = 0; i < common; ++i)
+		{
+			slot_type tmp;
+			value_type* held = reinterpret_cast<value_type*>(&tmp);
+			__relocate(held, __slot(i));
+			__relocate(__slot(i), other.__slot(i));
+			__relocate(other.__slot(i), held);
+		}
+		for(size_type i = common; i < other.__count; ++i)
+			__relocate(__slot(i), other.__slot(i));
+		for(size_type i = common; i < __count; ++i)
+			__relocate(other.__slot(i), __slot(i));
+		swap(__count, other.__count);
+		swap(__spilled, other.__spilled);
+	}
+
+	size_type size() const noexcept { return __spilled ? __large.size() : __count; }
+	size_type max_size() const noexcept { return __large.max_size(); }
+	allocator_type get_allocator() const { return __large.get_allocator(); }
+	hasher hash_function() const { return __large.hash_function(); }
+	key_equal key_eq() const { return __equal; }
+
+	// ITERATION
+	position first() const
+	{
+		if(__spilled)
+			return position{ NONE, __large.first() };
+		return position{ __count ? 0 : NONE, __large.last() };
+	}
+	position last() const { return position{ NONE, __large.last() }; }
+	void advance(position& p) const
+	{
+		if(__spilled)
+			__large.advance(p.large);
+		else if(++p.index == __count)
+			p.index = NONE;
+	}
+	value_type& value(position p) const { return __spilled ? __large.value(p.large) : *__slot(p.index); }
+
+	// BUCKETS
+	size_type bucket_count() const { return __spilled ? __large.bucket_count() : 1; }
+	size_type max_bucket_count() const { return __large.max_bucket_count(); }
+	size_type bucket(const key_type& key) const { return __spilled ? __large.bucket(key) : 0; }
+	size_type bucket_size(size_type n) const { return __spilled ? __large.bucket_size(n) : __count; }
+	local_position local_first(size_type n) const
+	{
+		if(__spilled)
+			return local_position{ NONE, __large.local_first(n) };
+		return local_position{ __count ? 0 : NONE, typename large_type::local_position() };
+	}
+	local_position local_last(size_type n) const
+	{
+		if(__spilled)
+			return local_position{ NONE, __large.local_last(n) };
+		return local_position{ NONE, typename large_type::local_position() };
+	}
+	void local_advance(local_position& p) const
+	{
+		if(__spilled)
+			__large.local_advance(p.large);
+		else if(++p.index == __count)
+			p.index = NONE;
+	}
+	value_type& local_value(local_position p) const
+	{ return __spilled ? __large.local_value(p.large) : *__slot(p.index); }
+
+	// HASH POLICY
+	float max_load_factor() const { return __large.max_load_factor(); }
+	void max_load_factor(float ml) { __large.max_load_factor(ml); }
+	float min_load_factor() const { return __large.min_load_factor(); }
+	void min_load_factor(float ml) { __large.min_load_factor(ml); }
+
+	// the inline array is part of the table object, so only the large
+	// storage, and the buckets it keeps after a clear(), count
+	hashTableMemory memory_usage() const { return __large.memory_usage(); }
+
+	// while inline the shape is one chain of every element; the counters
+	// are those of the large storage
+	hashTableStats stats() const
+	{
+		hashTableStats s = __large.stats();
+		if(__spilled)
+			return s;
+		s.size = __count;
+		s.bucket_count = 1;
+		s.load_factor = float(__count);
+		for(size_type i = 0; i < hashTableStats::HISTOGRAM; ++i)
+			s.chain_histogram[i] = 0;
+		++s.chain_histogram[hashTableStats::bin(__count)];
+		s.max_chain = __count;
+		return s;
+	}
+
+	// asking for more buckets than the array has elements moves to the
+	// large storage straight away, so a reserve() is honoured
+	void rehash(size_type count)
+	{
+		if(!__spilled && count <= size_type(CAPACITY))
+			return;
+		if(!__spilled)
+			__spill();
+		__large.rehash(count);
+	}
+	void rehash(size_type count, thread_count threads)
+	{
+		if(!__spilled && count <= size_type(CAPACITY))
+			return;
+		if(!__spilled)
+			__spill();
+		__large.rehash(count, threads);
+	}
+
+	// a range that fits stays inline; a larger one goes to the large
+	// storage in one go
+	template<class ForwardIt>
+	void insert_parallel(ForwardIt first, ForwardIt last, thread_count threads)
+	{
+		if(!__spilled && __count + static_cast<size_type>(std::distance(first, last)) <= size_type(CAPACITY))
+		{
+			for(; first != last; ++first)
+				try_emplace((*first).first, (*first).second);
+			return;
+		}
+		if(!__spilled)
+			__spill();
+		__large.insert_parallel(first, last, threads);
+	}
+
+	// LOOKUP
+	// K is key_type or, for transparent Hash and KeyEqual, anything they accept
+	template<class K>
+	position find(const K& key) const
+	{
+		if(__spilled)
+			return position{ NONE, __large.find(key) };
+		return __find(key);
+	}
+
+	// batches hash up front, but inline lookups ignore the hash
+	template<class K>
+	size_type hash_key(const K& key) const { return __large.hash_key(key); }
+	void prefetch(size_type hash) const
+	{
+		if(__spilled)
+			__large.prefetch(hash);
+	}
+	template<class K>
+	position find_hashed(const K& key, size_type hash) const
+	{
+		if(__spilled)
+			return position{ NONE, __large.find_hashed(key, hash) };
+		return __find(key);
+	}
+
+	// MODIFIERS
+	template<class K, class... Args>
+	pair<position, bool> try_emplace(K&& key, Args&&... args)
+	{
+		if(!__spilled)
+		{
+			position p = __find(key);
+			if(p != last())
+				return pair<position, bool>(p, false);
+			if(__count < size_type(CAPACITY))
+				return pair<position, bool>(__append(std::piecewise_construct,
+					std::forward_as_tuple(::forward<K>(key)), std::forward_as_tuple(::forward<Args>(args)...)), true);
+			__spill();
+		}
+		return __wrap(__large.try_emplace(::forward<K>(key), ::forward<Args>(args)...));
+	}
+
+	template<class K, class... Args>
+	pair<position, bool> try_emplace_hashed(size_type hash, K&& key, Args&&... args)
+	{
+		if(!__spilled)
+		{
+			position p = __find(key);
+			if(p != last())
+				return pair<position, bool>(p, false);
+			if(__count < size_type(CAPACITY))
+				return pair<position, bool>(__append(std::piecewise_construct,
+					std::forward_as_tuple(::forward<K>(key)), std::forward_as_tuple(::forward<Args>(args)...)), true);
+			__spill();
+		}
+		return __wrap(__large.try_emplace_hashed(hash, ::forward<K>(key), ::forward<Args>(args)...));
+	}
+
+	// the element is built in the next free slot before its key can be
+	// compared, and destroyed again if it is a duplicate
+	template<class... Args>
+	pair<position, bool> emplace(Args&&... args)
+	{
+		if(!__spilled)
+		{
+			if(__count < size_type(CAPACITY))
+			{
+				value_traits::construct(__value_alloc, __slot(__count), ::forward<Args>(args)...);
+				position p = __find_before(__slot(__count)->first, __count);
+				if(p != last())
+				{
+					value_traits::destroy(__value_alloc, __slot(__count));
+					return pair<position, bool>(p, false);
+				}
+				return pair<position, bool>(position{ __count++, __large.last() }, true);
+			}
+			value_type tmp(::forward<Args>(args)...);
+			position p = __find(tmp.first);
+			if(p != last())
+				return pair<position, bool>(p, false);
+			__spill();
+			return __wrap(__large.emplace(std::move(tmp)));
+		}
+		return __wrap(__large.emplace(::forward<Args>(args)...));
+	}
+
+	position erase(position p)
+	{
+		if(__spilled)
+			return position{ NONE, __large.erase(p.large) };
+		position next = p;
+		next.index = p.index + 1 < __count ? p.index : NONE;
+		__shift_down(p.index, p.index + 1);
+		return next;
+	}
+
+	position erase_range(position first, position last)
+	{
+		if(__spilled)
+			return position{ NONE, __large.erase_range(first.large, last.large) };
+		if(first == last)
+			return last;
+		size_type end = last.index == NONE ? __count : last.index;
+		__shift_down(first.index, end);
+		first.index = first.index < __count ? first.index : NONE;
+		return first;
+	}
+
+	template<class K>
+	size_type erase_key(const K& key)
+	{
+		position p = find(key);
+		if(p == last())
+			return 0;
+		erase(p);
+		return 1;
+	}
+
+	// inline elements leave in a node of the large storage's type, with
+	// its hash stored in case that node caches one
+	node* extract(position p)
+	{
+		if(__spilled)
+			return __large.extract(p.large);
+		value_type& v = *__slot(p.index);
+		node* n = __make_node<node>(get_allocator(), v.first, std::move(v.second));
+		try
+		{
+			n->store_hash(__large.hash_key(n->value.first));
+		}
+		catch(...)
+		{
+			__drop_node(get_allocator(), n);
+			throw;
+		}
+		__shift_down(p.index, p.index + 1);
+		return n;
+	}
+
+	pair<position, bool> insert_node(node* n, bool hash_valid)
+	{
+		if(!__spilled)
+		{
+			position p = __find(n->value.first);
+			if(p != last())
+				return pair<position, bool>(p, false);
+			if(__count < size_type(CAPACITY))
+			{
+				p = __append(n->value.first, std::move(n->value.second));
+				__drop_node(get_allocator(), n);
+				return pair<position, bool>(p, true);
+			}
+			__spill();
+		}
+		return __wrap(__large.insert_node(n, hash_valid));
+	}
+
+	void merge(smallStorage& source)
+	{
+		if(__spilled && source.__spilled)
+			__large.merge(source.__large);
+		else
+			__merge_values(*this, source);
+	}
+
+	// back to the inline array; the large storage keeps its buckets for
+	// the next time the table outgrows it
+	void clear() noexcept
+	{
+		__large.clear();
+		__destroy_inline();
+		__spilled = false;
+	}
+
+private:
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<value_type> value_allocator;
+	typedef std::allocator_traits<value_allocator> value_traits;
+	typedef typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type slot_type;
+
+	value_type* __slot(size_type i) const
+	{ return reinterpret_cast<value_type*>(const_cast<slot_type*>(__slots + i)); }
+
+	template<class K>
+	position __find(const K& key) const { return __find_before(key, __count); }
+
+	// linear search of the first n inline elements
+	template<class K>
+	position __find_before(const K& key, size_type n) const
+	{
+		for(size_type i = 0; i < n; ++i)
+			if(__equal(__slot(i)->first, key))
+				return position{ i, __large.last() };
+		return last();
+	}
+
+	template<class... Args>
+	position __append(Args&&... args)
+	{
+		value_traits::construct(__value_alloc, __slot(__count), ::forward<Args>(args)...);
+		return position{ __count++, __large.last() };
+	}
+
+	pair<position, bool> __wrap(pair<typename large_type::position, bool> result) const
+	{ return pair<position, bool>(position{ NONE, result.first }, result.second); }
+
+	// move *from into the raw slot to and end *from; a memcpy when
+	// value_type is trivially relocatable
+	void __relocate(value_type* to, value_type* from)
+	{ __relocate_n(__value_alloc, to, from, 1); }
+
+	// remove the inline elements [first, end) and close the gap
+	void __shift_down(size_type first, size_type end)
+	{
+		for(size_type i = first; i < end; ++i)
+			value_traits::destroy(__value_alloc, __slot(i));
+		for(size_type i = end; i < __count; ++i)
+			__relocate(__slot(first + i - end), __slot(i));
+		__count -= end - first;
+	}
+
+	// move the inline elements into the large storage. Keys are const, so
+	// they are copied; mapped values are moved only if that cannot throw
+	// and copied otherwise. The large storage builds each element in place
+	// after allocating for it, so a failure leaves the one it was given
+	// untouched, and the mapped values that did reach it are moved back by
+	// key: the table is unchanged, unless mapped_type can only be moved and
+	// its move may throw.
+	void __spill()
+	{
+		__large.rehash(static_cast<size_type>(std::ceil((__count + 1) / __large.max_load_factor())));
+		try
+		{
+			for(size_type i = 0; i < __count; ++i)
+				__large.try_emplace(__slot(i)->first, std::move_if_noexcept(__slot(i)->second));
+		}
+		catch(...)
+		{
+			if(std::is_nothrow_move_constructible<mapped_type>::value)
+				for(typename large_type::position p = __large.first(); p != __large.last(); __large.advance(p))
+				{
+					auto&& v = __large.value(p);
+					mapped_type* mapped = &__slot(__find(v.first).index)->second;
+					value_traits::destroy(__value_alloc, mapped);
+					value_traits::construct(__value_alloc, mapped, std::move(v.second));
+				}
+			__large.clear();
+			throw;
+		}
+		__destroy_inline();
+		__spilled = true;
+	}
+
+	// take over the inline elements of a table whose large storage was
+	// already moved from
+	void __take(smallStorage& other)
+	{
+		__take_inline(other, __bitwise_relocatable<value_allocator, value_type>());
+		other.__count = 0;
+		other.__spilled = false;
+	}
+
+	void __take_inline(smallStorage& other, std::true_type)
+	{
+		__relocate_n(__value_alloc, __slot(0), other.__slot(0), other.__count);
+		__count = other.__count;
+	}
+	void __take_inline(smallStorage& other, std::false_type)
+	{
+		for(; __count < other.__count; ++__count)
+			__relocate(__slot(__count), other.__slot(__count));
+	}
+
+	void __destroy_inline() noexcept
+	{
+		for(size_type i = 0; i < __count; ++i)
+			value_traits::destroy(__value_alloc, __slot(i));
+		__count = 0;
+	}
+
+	large_type __large;
+	key_equal __equal;
+	value_allocator __value_alloc;
+	slot_type __slots[CAPACITY];
+	size_type __count;
+	bool __spilled;		// the large storage holds the elements
+};
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+const typename smallStorage<Key, T, Hash, KeyEqual, Allocator, Policy>::size_type
+	smallStorage<Key, T, Hash, KeyEqual, Allocator, Policy>::NONE;
+
+#endif // __SMALL_STORAGE_H__
@@ -0,0 +1,822 @@
+#ifndef __SNAPSHOT_HASH_TABLE_H__
+#define __SNAPSHOT_HASH_TABLE_H__
+
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "epochDomain.hpp"
+
+// A hash table for data that is read far more often than it changes, such
+// as configuration or routing tables.
+//
+// Every state of the table is an immutable version. Readers take a
+// snapshot, which enters an epoch and loads the current version once; they
+// then find, count and iterate on it with no locks and no atomic
+// read-modify-write, and see the same contents however long they hold it.
+// Writers open a batch, which holds the writer lock and builds a draft of
+// the next version, and commit() publishes it with one store.
+//
+// Versions share structure. The buckets are grouped in pages of PAGE_SIZE,
+// a version is an array of page pointers, and chains are persistent lists:
+// a draft copies only the pages it touches, and within a page only the part
+// of a chain in front of the element it changes. Pages and nodes count the
+// versions that reach them, which only writers touch. A replaced version is
+// retired to the epoch domain, which hands it back once no snapshot taken
+// before the commit is still open. Whichever thread's retire() that
+// happens on, even another table's, only queues it; the next writer frees
+// whatever only it reached, so Allocator is only used under the writer
+// lock and need not be thread-safe.
+//
+// A snapshot must be dropped on the thread that took it, before the table
+// is destroyed. An open snapshot also holds back reclamation for every
+// table in the epoch domain, so keep them short lived.
+template<class Key,
+	class T = Key,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >
+> class snapshot_hashTable
+{
+	struct node;
+	struct page;
+	struct version;
+
+public:
+	enum { DEFAULT_BUCKET_SIZE = 64, PAGE_SIZE = 64 };
+
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	class const_iterator;
+	class snapshot;
+	class batch;
+
+	explicit snapshot_hashTable(size_type bucket_count = DEFAULT_BUCKET_SIZE,
+		const Hash& hash = Hash(),
+		const KeyEqual& equal = KeyEqual(),
+		const Allocator& alloc = Allocator());
+
+	snapshot_hashTable(const snapshot_hashTable&) = delete;
+	snapshot_hashTable& operator=(const snapshot_hashTable&) = delete;
+
+	~snapshot_hashTable();
+
+	// READERS
+	snapshot read() const;
+
+	// WRITERS
+	// batches are serialised: write() blocks while another one is open
+	batch write();
+	// one element batches; each returns true if the key was not present before
+	template<class M>
+	bool insert_or_assign(const key_type& k, M&& obj);
+	size_type erase(const key_type& key);
+
+	// CAPACITY
+	// of the latest committed version
+	size_type size() const noexcept;
+	bool empty() const noexcept;
+
+	// HASH POLICY
+	size_type bucket_count() const;
+	float max_load_factor() const;
+	// applies from the next batch on
+	void max_load_factor(float ml);
+
+	hasher hash_function() const { return __hash; }
+	key_equal key_eq() const { return __equal; }
+
+private:
+	// a chain link; immutable once built, and shared by every chain that
+	// reaches it, so refs counts the links and page slots pointing at it
+	struct node
+	{
+		template<class... Args>
+		node(size_type h, node* n, Args&&... args)
+			: value(::forward<Args>(args)...), hash(h), next(n), refs(1) {}
+
+		value_type value;
+		size_type hash;
+		node* next;
+		std::atomic<size_type> refs;
+	};
+
+	// PAGE_SIZE bucket heads; refs counts the versions using the page
+	struct page
+	{
+		page() : refs(1)
+		{
+			for(size_type i = 0; i < PAGE_SIZE; ++i)
+				heads[i] = nullptr;
+		}
+
+		std::atomic<size_type> refs;
+		node* heads[PAGE_SIZE];
+	};
+
+	struct version
+	{
+		size_type bucket_count;
+		size_type size;
+		page** pages;
+		version* next;		// on __reclaimed, once handed back
+	};
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+
+	static const node* __head(const version* v, size_type bucket)
+		{ return v->pages[bucket / PAGE_SIZE]->heads[bucket % PAGE_SIZE]; }
+	const node* __find(const version* v, const key_type& key, size_type hash) const;
+
+	// building drafts, under the writer lock
+	version* __create_version(size_type bucket_count);
+	version* __clone(const version* v);
+	node*& __writable_head(version* draft, size_type hash);
+	node* __copy_prefix(node* n, const node* end, node* tail);
+	void __replace_prefix(node*& head, node* found, node* tail);
+	void __maybe_grow(version*& draft);
+	void __publish(version* draft);
+
+	template<class... Args>
+	node* __create_node(size_type hash, node* next, Args&&... args);
+	void __release(node* n);
+	void __release(page* p);
+	void __release(version* v);
+	void __reclaim();
+	static void __free_version(void* owner, void* ptr);
+
+	hasher __hash;
+	key_equal __equal;
+	node_allocator __node_alloc;
+	std::atomic<version*> __current;
+	std::atomic<size_type> __size;			// __current->size, readable without a snapshot
+	std::atomic<size_type> __bucket_count;	// __current->bucket_count
+	std::atomic<float> __desired_load_factor;
+	std::atomic<version*> __reclaimed;		// handed back by the epoch domain, to free
+	std::mutex __write_lock;
+};
+
+// Const Iterator
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+class snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::const_iterator
+{
+	friend class snapshot_hashTable;
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename snapshot_hashTable::value_type value_type;
+	typedef typename snapshot_hashTable::difference_type difference_type;
+	typedef const value_type* pointer;
+	typedef const value_type& reference;
+
+	constexpr const_iterator()
+		: table(nullptr), bucket(0), n(nullptr) {}
+
+	const_iterator& operator++()
+		{ n = n->next; __settle(); return *this; }
+	const_iterator operator++(int)
+		{ const_iterator tmp(*this); ++*this; return tmp; }
+
+	pointer operator->() const
+		{ return std::addressof(n->value); }
+	reference operator*() const
+		{ return n->value; }
+
+	friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+		{ return lhs.n == rhs.n; }
+	friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
+		{ return lhs.n != rhs.n; }
+
+private:
+	const_iterator(const version* __table_, size_type __bucket_, const node* __n_)
+		: table(__table_), bucket(__bucket_), n(__n_) {}
+
+	// move on to the first element of a later bucket once a chain runs out
+	void __settle()
+	{
+		while(!n && ++bucket < table->bucket_count)
+			n = __head(table, bucket);
+	}
+
+	const version* table;
+	size_type bucket;
+	const node* n;
+}; // End Const Iterator
+
+// Snapshot
+// A reader's view of one version. It stays valid and unchanged until the
+// snapshot is destroyed, whatever writers commit meanwhile.
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+class snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::snapshot
+{
+	friend class snapshot_hashTable;
+public:
+	typedef typename snapshot_hashTable::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+	snapshot(snapshot&& other) noexcept
+		: __table(other.__table), __record(other.__record), __version(other.__version)
+		{ other.__record = nullptr; }
+	snapshot& operator=(const snapshot&) = delete;
+
+	~snapshot()
+	{
+		if(__record)
+			epochDomain::global().leave(__record);
+	}
+
+	const_iterator begin() const
+	{
+		const_iterator it(__version, 0, __head(__version, 0));
+		it.__settle();
+		return it;
+	}
+	const_iterator end() const { return const_iterator(__version, __version->bucket_count, nullptr); }
+
+	const_iterator find(const key_type& key) const
+	{
+		size_type hash = __mix_hash(__table->__hash(key));
+		const node* n = __table->__find(__version, key, hash);
+		return n ? const_iterator(__version, hash & (__version->bucket_count - 1), n) : end();
+	}
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type& key) const
+		{ return __table->__find(__version, key, __mix_hash(__table->__hash(key))) != nullptr; }
+	const mapped_type& at(const key_type& key) const
+	{
+		const node* n = __table->__find(__version, key, __mix_hash(__table->__hash(key)));
+		if(!n)
+			throw std::out_of_range("snapshot_hashTable::snapshot::at");
+		return n->value.second;
+	}
+
+	size_type size() const noexcept { return __version->size; }
+	bool empty() const noexcept { return __version->size == 0; }
+	size_type bucket_count() const { return __version->bucket_count; }
+
+private:
+	explicit snapshot(const snapshot_hashTable& table)
+		: __table(&table), __record(__epoch_record())
+	{
+		epochDomain::global().enter(__record);
+		__version = table.__current.load(std::memory_order_acquire);
+	}
+
+	const snapshot_hashTable* __table;
+	epochDomain::record* __record;
+	const version* __version;
+}; // End Snapshot
+
+// Batch
+// A writer's draft of the next version. Edits stay private until commit();
+// a batch destroyed without one leaves the table as it was.
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+class snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::batch
+{
+	friend class snapshot_hashTable;
+public:
+	batch(batch&& other) noexcept
+		: __table(other.__table), __lock(std::move(other.__lock)), __draft(other.__draft)
+		{ other.__draft = nullptr; }
+	batch& operator=(const batch&) = delete;
+
+	~batch()
+	{
+		if(__draft)
+			__table->__release(__draft);
+	}
+
+	// each returns true if the key was not present before
+	template<class M>
+	bool insert_or_assign(const key_type& k, M&& obj)
+	{
+		size_type hash = __mix_hash(__table->__hash(k));
+		node* found = const_cast<node*>(__table->__find(__draft, k, hash));
+		node*& head = __table->__writable_head(__draft, hash);
+		if(found)
+		{
+			node* tail = found->next;
+			if(tail)
+				tail->refs.fetch_add(1, std::memory_order_relaxed);
+			node* replacement;
+			try
+			{
+				replacement = __table->__create_node(hash, tail, k, ::forward<M>(obj));
+			}
+			catch(...)
+			{
+				__table->__release(tail);
+				throw;
+			}
+			__table->__replace_prefix(head, found, replacement);
+			return false;
+		}
+		// a new element goes in front, so the old chain is shared as it is
+		head = __table->__create_node(hash, head, k, ::forward<M>(obj));
+		++__draft->size;
+		__table->__maybe_grow(__draft);
+		return true;
+	}
+
+	template<class... Args>
+	bool try_emplace(const key_type& k, Args&&... args)
+	{
+		size_type hash = __mix_hash(__table->__hash(k));
+		if(__table->__find(__draft, k, hash))
+			return false;
+		node*& head = __table->__writable_head(__draft, hash);
+		head = __table->__create_node(hash, head, std::piecewise_construct,
+			std::forward_as_tuple(k), std::forward_as_tuple(::forward<Args>(args)...));
+		++__draft->size;
+		__table->__maybe_grow(__draft);
+		return true;
+	}
+
+	size_type erase(const key_type& key)
+	{
+		size_type hash = __mix_hash(__table->__hash(key));
+		node* found = const_cast<node*>(__table->__find(__draft, key, hash));
+		if(!found)
+			return 0;
+		node*& head = __table->__writable_head(__draft, hash);
+		node* tail = found->next;
+		if(tail)
+			tail->refs.fetch_add(1, std::memory_order_relaxed);
+		__table->__replace_prefix(head, found, tail);
+		--__draft->size;
+		return 1;
+	}
+
+	void clear()
+	{
+		version* empty = __table->__create_version(__draft->bucket_count);
+		__table->__release(__draft);
+		__draft = empty;
+	}
+
+	// the draft, edits included
+	bool contains(const key_type& key) const
+		{ return __table->__find(__draft, key, __mix_hash(__table->__hash(key))) != nullptr; }
+	size_type size() const noexcept { return __draft->size; }
+
+	// publish the draft and release the writer lock; the batch is done
+	void commit()
+	{
+		__table->__publish(__draft);
+		__draft = nullptr;
+		__table->__reclaim();
+		__lock.unlock();
+	}
+
+private:
+	explicit batch(snapshot_hashTable& table)
+		: __table(&table), __lock(table.__write_lock), __draft(nullptr)
+	{
+		table.__reclaim();
+		__draft = table.__clone(table.__current.load(std::memory_order_relaxed));
+	}
+
+	snapshot_hashTable* __table;
+	std::unique_lock<std::mutex> __lock;
+	version* __draft;
+}; // End Batch
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::snapshot_hashTable(
+		size_type bucket_count,
+		const Hash& hash,
+		const KeyEqual& equal,
+		const Allocator& alloc)
+	: __hash(hash), __equal(equal), __node_alloc(alloc), __current(nullptr), __size(0), __bucket_count(0),
+	  __desired_load_factor(1.0f), __reclaimed(nullptr)
+{
+	// make sure the domain outlives this table even if it is static
+	epochDomain::global();
+
+	version* v = __create_version(__next_pow2(bucket_count > size_type(PAGE_SIZE) ? bucket_count : size_type(PAGE_SIZE)));
+	__current.store(v);
+	__bucket_count.store(v->bucket_count);
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::~snapshot_hashTable()
+{
+	__release(__current.load());
+	epochDomain::global().drain(this);
+	__reclaim();
+}
+
+// READERS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::snapshot snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::read() const
+{ return snapshot(*this); }
+
+// WRITERS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::batch snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::write()
+{ return batch(*this); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class M>
+bool snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::insert_or_assign(const key_type& k, M&& obj)
+{
+	batch b = write();
+	bool inserted = b.insert_or_assign(k, ::forward<M>(obj));
+	b.commit();
+	return inserted;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::erase(const key_type& key)
+{
+	batch b = write();
+	size_type erased = b.erase(key);
+	if(erased)
+		b.commit();
+	return erased;
+}
+
+// CAPACITY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::size() const noexcept
+{ return __size.load(std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline bool snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::empty() const noexcept
+{ return size() == 0; }
+
+// HASH POLICY
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::size_type snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::bucket_count() const
+{ return __bucket_count.load(std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline float snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::max_load_factor() const
+{ return __desired_load_factor.load(std::memory_order_relaxed); }
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+inline void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::max_load_factor(float ml)
+{ __desired_load_factor.store(ml, std::memory_order_relaxed); }
+
+// INTERNALS
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+const typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::node* snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__find(const version* v, const key_type& key, size_type hash) const
+{
+	for(const node* n = __head(v, hash & (v->bucket_count - 1)); n; n = n->next)
+		if(n->hash == hash && __equal(n->value.first, key))
+			return n;
+	return nullptr;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::version* snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__create_version(size_type bucket_count)
+{
+	size_type page_count = bucket_count / PAGE_SIZE;
+	version* v = new version;
+	v->bucket_count = bucket_count;
+	v->size = 0;
+	try
+	{
+		v->pages = new page*[page_count];
+	}
+	catch(...)
+	{
+		delete v;
+		throw;
+	}
+	size_type i = 0;
+	try
+	{
+		for(; i < page_count; ++i)
+			v->pages[i] = new page;
+	}
+	catch(...)
+	{
+		while(i > 0)
+			delete v->pages[--i];
+		delete[] v->pages;
+		delete v;
+		throw;
+	}
+	return v;
+}
+
+// a draft that shares every page with v
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::version* snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__clone(const version* v)
+{
+	size_type page_count = v->bucket_count / PAGE_SIZE;
+	version* draft = new version;
+	*draft = *v;
+	try
+	{
+		draft->pages = new page*[page_count];
+	}
+	catch(...)
+	{
+		delete draft;
+		throw;
+	}
+	for(size_type i = 0; i < page_count; ++i)
+	{
+		draft->pages[i] = v->pages[i];
+		draft->pages[i]->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	return draft;
+}
+
+// the head of hash's chain in a page only the draft uses, copying the page
+// first if a published version shares it; only writers take references, so
+// a count of one under the writer lock cannot rise behind our back
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::node*& snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__writable_head(version* draft, size_type hash)
+{
+	size_type bucket = hash & (draft->bucket_count - 1);
+	page*& p = draft->pages[bucket / PAGE_SIZE];
+	if(p->refs.load(std::memory_order_acquire) != 1)
+	{
+		page* copy = new page;
+		for(size_type i = 0; i < PAGE_SIZE; ++i)
+			if((copy->heads[i] = p->heads[i]))
+				copy->heads[i]->refs.fetch_add(1, std::memory_order_relaxed);
+		__release(p);
+		p = copy;
+	}
+	return p->heads[bucket % PAGE_SIZE];
+}
+
+// copies of the nodes from n up to end, linked in front of tail; takes
+// over the reference to tail, and drops it if a copy throws
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::node* snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__copy_prefix(node* n, const node* end, node* tail)
+{
+	if(n == end)
+		return tail;
+	node* rest = __copy_prefix(n->next, end, tail);
+	try
+	{
+		return __create_node(n->hash, rest, n->value);
+	}
+	catch(...)
+	{
+		__release(rest);
+		throw;
+	}
+}
+
+// drop found from the chain at head, which a private page holds: the nodes
+// in front of it are copied and linked to tail, which replaces it and whose
+// reference is taken over; published versions keep the old chain
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__replace_prefix(node*& head, node* found, node* tail)
+{
+	node* chain = __copy_prefix(head, found, tail);
+	node* old = head;
+	head = chain;
+	__release(old);
+}
+
+// double the draft's buckets once it outgrows the load factor; the nodes
+// are shared with published versions, so every one is copied
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__maybe_grow(version*& draft)
+{
+	if(draft->size <= draft->bucket_count * max_load_factor())
+		return;
+	size_type target = draft->bucket_count;
+	while(draft->size > target * max_load_factor())
+		target *= 2;
+	version* fresh = nullptr;
+	try
+	{
+		fresh = __create_version(target);
+		for(size_type b = 0; b < draft->bucket_count; ++b)
+			for(const node* n = __head(draft, b); n; n = n->next)
+			{
+				size_type bucket = n->hash & (target - 1);
+				node*& head = fresh->pages[bucket / PAGE_SIZE]->heads[bucket % PAGE_SIZE];
+				head = __create_node(n->hash, head, n->value);
+			}
+	}
+	catch(...)
+	{
+		// growing is an optimisation; keep the draft as it was
+		if(fresh)
+			__release(fresh);
+		return;
+	}
+	fresh->size = draft->size;
+	__release(draft);
+	draft = fresh;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__publish(version* draft)
+{
+	version* old = __current.load(std::memory_order_relaxed);
+	__current.store(draft, std::memory_order_release);
+	__size.store(draft->size, std::memory_order_relaxed);
+	__bucket_count.store(draft->bucket_count, std::memory_order_relaxed);
+	epochDomain::global().retire(this, old, &__free_version);
+}
+
+// builds a node that owns one reference to next
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+	template<class... Args>
+typename snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::node* snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__create_node(size_type hash, node* next, Args&&... args)
+{
+	node* n = node_traits::allocate(__node_alloc, 1);
+	try
+	{
+		node_traits::construct(__node_alloc, n, hash, next, ::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		node_traits::deallocate(__node_alloc, n, 1);
+		throw;
+	}
+	return n;
+}
+
+// drop one reference to n, freeing it and whatever only it reached
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__release(node* n)
+{
+	while(n && n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		node* next = n->next;
+		node_traits::destroy(__node_alloc, n);
+		node_traits::deallocate(__node_alloc, n, 1);
+		n = next;
+	}
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__release(page* p)
+{
+	if(p->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	for(size_type i = 0; i < PAGE_SIZE; ++i)
+		__release(p->heads[i]);
+	delete p;
+}
+
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__release(version* v)
+{
+	for(size_type i = 0; i < v->bucket_count / PAGE_SIZE; ++i)
+		__release(v->pages[i]);
+	delete[] v->pages;
+	delete v;
+}
+
+// free the versions the epoch domain has handed back; under the writer
+// lock, or in the destructor
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__reclaim()
+{
+	version* v = __reclaimed.exchange(nullptr, std::memory_order_acquire);
+	while(v)
+	{
+		version* next = v->next;
+		__release(v);
+		v = next;
+	}
+}
+
+// may run on any thread that retires into the domain, so it only queues
+// the version for the owning table's writer
+template<class Key,
+	class T,
+	class Hash,
+	class KeyEqual,
+	class Allocator>
+void snapshot_hashTable<Key, T, Hash, KeyEqual, Allocator>::__free_version(void* owner, void* ptr)
+{
+	snapshot_hashTable* table = static_cast<snapshot_hashTable*>(owner);
+	version* v = static_cast<version*>(ptr);
+	v->next = table->__reclaimed.load(std::memory_order_relaxed);
+	while(!table->__reclaimed.compare_exchange_weak(v->next, v, std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+#endif // __SNAPSHOT_HASH_TABLE_H__
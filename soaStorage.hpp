@@ -0,0 +1,623 @@
+#ifndef __SOA_STORAGE_H__
+#define __SOA_STORAGE_H__
+
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "utility.hpp"
+#include "hashPolicy.hpp"
+#include "controlGroup.hpp"
+#include "nodeHandle.hpp"
+#include "parallel.hpp"
+#include "tableStats.hpp"
+
+// Structure of arrays storage: open addressing like flatStorage, but keys
+// and mapped values sit in two parallel arrays instead of one array of
+// value_type. Probes only read control bytes and keys, so with small keys
+// and large values a lookup pulls a fraction of the cache lines flat
+// storage would, and the one mapped value it returns is the only one it
+// touches.
+//
+// There is no value_type object to point at, so value() returns a
+// pair_reference and iterators hand those out; it->first and it->second
+// work as usual, but auto& cannot bind to *it.
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, class Policy>
+class soaStorage
+{
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef pair_reference<const Key, T> reference;
+	typedef pair_reference<const Key, const T> const_reference;
+	typedef std::size_t size_type;
+	typedef Hash hasher;
+	typedef KeyEqual key_equal;
+	typedef Allocator allocator_type;
+
+	// a slot index, capacity() is the end
+	typedef size_type position;
+	typedef size_type local_position;
+	typedef __valueNode<value_type> node;
+
+	enum { DEFAULT_MAX_LOAD_FACTOR_PERCENT = 875, MAX_LOAD_FACTOR_PERCENT = 950 };
+
+	soaStorage(size_type bucket_count, const hasher& hash,
+		const key_equal& equal, const allocator_type& alloc)
+		: __hash(hash), __equal(equal), __key_alloc(alloc), __mapped_alloc(alloc), __ctrl_alloc(alloc),
+		  __keys(nullptr), __mapped(nullptr), __ctrl(nullptr), __capacity(0), __size(0), __deleted(0),
+		  __desired_load_factor(DEFAULT_MAX_LOAD_FACTOR_PERCENT / 1000.0f)
+		{ __allocate(bucket_count ? __round_capacity(bucket_count) : 0); }
+
+	soaStorage(const soaStorage& other)
+		: soaStorage(other, key_traits::select_on_container_copy_construction(other.__key_alloc)) {}
+	soaStorage(const soaStorage& other, const allocator_type& alloc)
+		: __hash(other.__hash), __equal(other.__equal), __key_alloc(alloc), __mapped_alloc(alloc), __ctrl_alloc(alloc),
+		  __keys(nullptr), __mapped(nullptr), __ctrl(nullptr), __capacity(0), __size(0), __deleted(0),
+		  __desired_load_factor(other.__desired_load_factor), __floor(other.__floor.min_load_factor)
+	{
+		__allocate(other.__capacity);
+		try
+		{
+			// keep the exact slot layout, tombstones included, so that every
+			// probe run stays intact
+			for(size_type i = 0; i < other.__capacity; ++i)
+			{
+				if(__ctrl_full(other.__ctrl[i]))
+				{
+					__construct_slot(i, other.__keys[i], other.__mapped[i]);
+					++__size;
+				}
+				__ctrl[i] = other.__ctrl[i];
+			}
+			__deleted = other.__deleted;
+		}
+		catch(...)
+		{
+			clear();
+			__deallocate();
+			throw;
+		}
+	}
+
+	soaStorage(soaStorage&& other) noexcept
+		: __hash(std::move(other.__hash)), __equal(std::move(other.__equal)),
+		  __key_alloc(std::move(other.__key_alloc)), __mapped_alloc(std::move(other.__mapped_alloc)),
+		  __ctrl_alloc(std::move(other.__ctrl_alloc)),
+		  __keys(other.__keys), __mapped(other.__mapped), __ctrl(other.__ctrl), __capacity(other.__capacity),
+		  __size(other.__size), __deleted(other.__deleted),
+		  __desired_load_factor(other.__desired_load_factor), __floor(other.__floor), __stats(other.__stats)
+	{
+		other.__keys = nullptr;
+		other.__mapped = nullptr;
+		other.__ctrl = nullptr;
+		other.__capacity = 0;
+		other.__size = 0;
+		other.__deleted = 0;
+	}
+	soaStorage(soaStorage&& other, const allocator_type& alloc)
+		: soaStorage(0, other.__hash, other.__equal, alloc)
+	{
+		__desired_load_factor = other.__desired_load_factor;
+		__floor.min_load_factor = other.__floor.min_load_factor;
+		if(__key_alloc == other.__key_alloc)
+		{
+			swap(other);
+			return;
+		}
+		rehash(other.__capacity);
+		for(position p = other.first(); p != other.last(); other.advance(p))
+		{
+			size_type hash = __mix_hash(__hash(other.__keys[p]));
+			__construct_at(__find_free(hash), hash, std::move(other.__keys[p]), std::move(other.__mapped[p]));
+		}
+		other.clear();
+	}
+
+	~soaStorage()
+	{
+		clear();
+		__deallocate();
+	}
+
+	void swap(soaStorage& other) noexcept
+	{
+		using std::swap;
+		swap(__hash, other.__hash);
+		swap(__equal, other.__equal);
+		if(key_traits::propagate_on_container_swap::value)
+		{
+			swap(__key_alloc, other.__key_alloc);
+			swap(__mapped_alloc, other.__mapped_alloc);
+			swap(__ctrl_alloc, other.__ctrl_alloc);
+		}
+		swap(__keys, other.__keys);
+		swap(__mapped, other.__mapped);
+		swap(__ctrl, other.__ctrl);
+		swap(__capacity, other.__capacity);
+		swap(__size, other.__size);
+		swap(__deleted, other.__deleted);
+		swap(__desired_load_factor, other.__desired_load_factor);
+		swap(__floor, other.__floor);
+		swap(__stats, other.__stats);
+	}
+
+	size_type size() const noexcept { return __size; }
+	size_type max_size() const noexcept
+	{
+		size_type keys = key_traits::max_size(__key_alloc), mapped = mapped_traits::max_size(__mapped_alloc);
+		return keys < mapped ? keys : mapped;
+	}
+	allocator_type get_allocator() const { return allocator_type(__key_alloc); }
+	hasher hash_function() const { return __hash; }
+	key_equal key_eq() const { return __equal; }
+
+	// ITERATION
+	position first() const
+	{
+		position p = 0;
+		while(p < __capacity && !__ctrl_full(__ctrl[p]))
+			++p;
+		return p;
+	}
+	position last() const { return __capacity; }
+	void advance(position& p) const
+	{
+		do
+			++p;
+		while(p < __capacity && !__ctrl_full(__ctrl[p]));
+	}
+	reference value(position p) const { return reference(__keys[p], __mapped[p]); }
+
+	// BUCKETS
+	// every slot is a bucket holding at most one element; a missing key maps
+	// to the first slot of the group its probe starts at
+	size_type bucket_count() const { return __capacity; }
+	size_type max_bucket_count() const { return max_size(); }
+	size_type bucket(const key_type& key) const
+	{
+		size_type hash = __hash(key);
+		position p = __find(key, hash);
+		return p != last() ? p : __group_index(__mix_hash(hash)) * ctrlGroup::WIDTH;
+	}
+	size_type bucket_size(size_type n) const { return __ctrl_full(__ctrl[n]) ? 1 : 0; }
+	local_position local_first(size_type n) const { return __ctrl_full(__ctrl[n]) ? n : n + 1; }
+	local_position local_last(size_type n) const { return n + 1; }
+	void local_advance(local_position& p) const { ++p; }
+	reference local_value(local_position p) const { return value(p); }
+
+	// HASH POLICY
+	// probing needs at least one empty slot, so the load factor is capped
+	float max_load_factor() const { return __desired_load_factor; }
+	void max_load_factor(float ml)
+	{
+		float cap = MAX_LOAD_FACTOR_PERCENT / 1000.0f;
+		__desired_load_factor = ml < cap ? ml : cap;
+	}
+	float min_load_factor() const { return __floor.min_load_factor; }
+	void min_load_factor(float ml) { __floor.min_load_factor = ml; }
+
+	hashTableMemory memory_usage() const
+	{
+		hashTableMemory m;
+		m.add_buckets(__capacity * sizeof(ctrl_t));
+		m.add_elements(__capacity * sizeof(key_type));
+		m.add_elements(__capacity * sizeof(mapped_type));
+		return m;
+	}
+
+	hashTableStats stats() const
+	{
+		hashTableStats s;
+		s.size = __size;
+		s.bucket_count = __capacity;
+		s.load_factor = __capacity ? float(__size) / __capacity : 0.0f;
+		for(size_type i = 0; i < __capacity; ++i)
+			if(__ctrl_full(__ctrl[i]))
+			{
+				size_type length = __probe_length(__mix_hash(__hash(__keys[i])), i);
+				++s.chain_histogram[hashTableStats::bin(length)];
+				if(length > s.max_chain)
+					s.max_chain = length;
+			}
+		__stats.fill(s);
+		return s;
+	}
+
+	void rehash(size_type count)
+	{
+		size_type capacity = __capacity_for(__size);
+		if(count > capacity)
+			capacity = __round_capacity(count);
+		if(capacity == __capacity && __deleted == 0)
+			return;
+		__resize(capacity);
+	}
+
+	// as for flat storage, only the hashing runs in parallel
+	void rehash(size_type count, thread_count) { rehash(count); }
+
+	template<class ForwardIt>
+	void insert_parallel(ForwardIt first, ForwardIt last, thread_count threads)
+	{
+		size_type count = static_cast<size_type>(std::distance(first, last));
+		rehash(static_cast<size_type>(std::ceil((__size + count) / __desired_load_factor)));
+		std::vector<size_type> hashes = __hash_parallel(first, count, threads.for_size(count),
+			[this](const auto& value) { return __hash(value.first); });
+		for(size_type i = 0; i < count; ++i, ++first)
+			try_emplace_hashed(hashes[i], (*first).first, (*first).second);
+	}
+
+	// LOOKUP
+	// K is key_type or, for transparent Hash and KeyEqual, anything they accept
+	template<class K>
+	position find(const K& key) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, __hash(key));
+	}
+
+	// lookups split in two, for batches: hash every key, prefetch, then find
+	template<class K>
+	size_type hash_key(const K& key) const { return __hash(key); }
+	// pull in the first group a lookup of hash would probe, keys only
+	void prefetch(size_type hash) const
+	{
+		if(__capacity == 0)
+			return;
+		size_type base = __group_index(__mix_hash(hash)) * ctrlGroup::WIDTH;
+		__builtin_prefetch(__ctrl + base);
+		__builtin_prefetch(__keys + base);
+	}
+	template<class K>
+	position find_hashed(const K& key, size_type hash) const
+	{
+		if(__size == 0)
+			return last();
+		return __find(key, hash);
+	}
+
+	// MODIFIERS
+	template<class K, class... Args>
+	pair<position, bool> try_emplace(K&& key, Args&&... args)
+	{
+		size_type hash = __hash(key);
+		return try_emplace_hashed(hash, ::forward<K>(key), ::forward<Args>(args)...);
+	}
+
+	// try_emplace for a key whose hash_key() is already known
+	template<class K, class... Args>
+	pair<position, bool> try_emplace_hashed(size_type hash, K&& key, Args&&... args)
+	{
+		position p = __find(key, hash);
+		if(p != last())
+			return pair<position, bool>(p, false);
+		__reserve_one();
+		hash = __mix_hash(hash);
+		p = __find_free(hash);
+		__construct_at(p, hash, ::forward<K>(key), ::forward<Args>(args)...);
+		return pair<position, bool>(p, true);
+	}
+
+	template<class... Args>
+	pair<position, bool> emplace(Args&&... args)
+	{
+		// a key that is not const, so that it can be moved into place
+		pair<key_type, mapped_type> tmp(::forward<Args>(args)...);
+		size_type hash = __hash(tmp.first);
+		position p = __find(tmp.first, hash);
+		if(p != last())
+			return pair<position, bool>(p, false);
+		__reserve_one();
+		hash = __mix_hash(hash);
+		p = __find_free(hash);
+		__construct_at(p, hash, std::move(tmp.first), std::move(tmp.second));
+		return pair<position, bool>(p, true);
+	}
+
+	position erase(position p)
+	{
+		__destroy_slot(p);
+		--__size;
+		__floor.erased(__size, __capacity, __desired_load_factor);
+		// as in flat storage, a slot whose group still has an empty one
+		// needs no tombstone
+		if(ctrlGroup(__ctrl + p / ctrlGroup::WIDTH * ctrlGroup::WIDTH).match_empty())
+			__ctrl[p] = CTRL_EMPTY;
+		else
+		{
+			__ctrl[p] = CTRL_DELETED;
+			++__deleted;
+		}
+		advance(p);
+		return p;
+	}
+
+	position erase_range(position first, position last)
+	{
+		while(first != last)
+			first = erase(first);
+		return first;
+	}
+
+	template<class K>
+	size_type erase_key(const K& key)
+	{
+		position p = find(key);
+		if(p == last())
+			return 0;
+		erase(p);
+		return 1;
+	}
+
+	// elements leave and enter as __valueNodes, see nodeHandle.hpp
+	node* extract(position p) { return __extract_value(*this, p); }
+	pair<position, bool> insert_node(node* n, bool) { return __insert_value(*this, n); }
+	void merge(soaStorage& source) { __merge_values(*this, source); }
+
+	void clear() noexcept
+	{
+		for(size_type i = 0; i < __capacity; ++i)
+			if(__ctrl_full(__ctrl[i]))
+				__destroy_slot(i);
+		if(__ctrl)
+			std::memset(__ctrl, CTRL_EMPTY, __capacity);
+		__size = 0;
+		__deleted = 0;
+		// with a minimum load factor the arrays go too, and the next insert
+		// allocates small ones
+		if(__floor.min_load_factor > 0)
+			__deallocate();
+	}
+
+private:
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<key_type> key_allocator;
+	typedef std::allocator_traits<key_allocator> key_traits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<mapped_type> mapped_allocator;
+	typedef std::allocator_traits<mapped_allocator> mapped_traits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<ctrl_t> ctrl_allocator;
+	typedef std::allocator_traits<ctrl_allocator> ctrl_traits;
+	typedef statsRecorder<Policy::STATS != 0> stats_type;
+
+	// the high bits of the mixed hash pick the first group to probe, the
+	// low 7 bits are kept in the control byte
+	size_type __group_index(size_type hash) const { return (hash >> 7) & (__capacity / ctrlGroup::WIDTH - 1); }
+	static ctrl_t __h2(size_type hash) { return static_cast<ctrl_t>(hash & 0x7f); }
+
+	// the probe of flat storage, comparing against the key array
+	template<class K>
+	position __find(const K& key, size_type hash) const
+	{
+		if(__capacity == 0)
+			return last();
+		hash = __mix_hash(hash);
+		ctrl_t h2 = __h2(hash);
+		size_type mask = __capacity / ctrlGroup::WIDTH - 1;
+		size_type g = __group_index(hash);
+		for(size_type step = 1;; g = (g + step++) & mask)
+		{
+			size_type base = g * ctrlGroup::WIDTH;
+			ctrlGroup group(__ctrl + base);
+			for(typename ctrlGroup::mask_type m = group.match(h2); m; m &= m - 1)
+			{
+				size_type i = base + ctrlGroup::index(m);
+				if(__equal(__keys[i], key))
+				{
+					__stats.probe(step);
+					return i;
+				}
+			}
+			if(group.match_empty())
+			{
+				__stats.probe(step);
+				return last();
+			}
+		}
+	}
+
+	// first empty or deleted slot on the probe sequence of a mixed hash
+	position __find_free(size_type hash)
+	{
+		size_type mask = __capacity / ctrlGroup::WIDTH - 1;
+		size_type g = __group_index(hash);
+		for(size_type step = 1;; g = (g + step++) & mask)
+		{
+			size_type base = g * ctrlGroup::WIDTH;
+			typename ctrlGroup::mask_type m = ctrlGroup(__ctrl + base).match_empty_or_deleted();
+			if(m)
+			{
+				__stats.chain(step, Policy::CHAIN_WARNING);
+				return base + ctrlGroup::index(m);
+			}
+		}
+	}
+
+	// groups a probe for a mixed hash visits to reach slot p
+	size_type __probe_length(size_type hash, position p) const
+	{
+		size_type mask = __capacity / ctrlGroup::WIDTH - 1;
+		size_type g = __group_index(hash);
+		size_type step = 1;
+		for(; g != p / ctrlGroup::WIDTH; g = (g + step++) & mask);
+		return step;
+	}
+
+	// capacities are powers of two and at least one group wide
+	static size_type __round_capacity(size_type n)
+	{
+		return __next_pow2(n < size_type(ctrlGroup::WIDTH) ? size_type(ctrlGroup::WIDTH) : n);
+	}
+
+	// move every element into fresh arrays of the given capacity
+	void __resize(size_type capacity)
+	{
+		typename stats_type::time_point start = __stats.rehash_begin();
+		key_type* old_keys = __keys;
+		mapped_type* old_mapped = __mapped;
+		ctrl_t* old_ctrl = __ctrl;
+		size_type old_capacity = __capacity;
+		__keys = nullptr;
+		__mapped = nullptr;
+		__ctrl = nullptr;
+		try
+		{
+			__allocate(capacity);
+		}
+		catch(...)
+		{
+			// the capacity only changes once all three arrays exist
+			__keys = old_keys;
+			__mapped = old_mapped;
+			__ctrl = old_ctrl;
+			throw;
+		}
+		__size = 0;
+		__deleted = 0;
+		for(size_type i = 0; i < old_capacity; ++i)
+			if(__ctrl_full(old_ctrl[i]))
+			{
+				size_type hash = __mix_hash(__hash(old_keys[i]));
+				position p = __find_free(hash);
+				__relocate_slot(p, old_keys + i, old_mapped + i);
+				__ctrl[p] = __h2(hash);
+				++__size;
+			}
+		if(old_keys)
+			__deallocate_arrays(old_keys, old_mapped, old_ctrl, old_capacity);
+		__stats.rehash_end(start);
+	}
+
+	// smallest capacity that holds n elements within the load factor and
+	// still leaves an empty slot to end probes
+	size_type __capacity_for(size_type n) const
+	{
+		size_type capacity = ctrlGroup::WIDTH;
+		while(n >= capacity || n > capacity * __desired_load_factor)
+			capacity *= 2;
+		return capacity;
+	}
+
+	// make sure one more element fits without breaking the load factor;
+	// tombstones are flushed in place unless the table is more than half full
+	void __reserve_one()
+	{
+		if(__floor.due(__size, __capacity, __desired_load_factor))
+			rehash(__loadFloor::target(__size + 1, __desired_load_factor));
+		if(__size + __deleted + 1 <= __capacity * __desired_load_factor && __size + __deleted + 1 < __capacity)
+			return;
+		size_type capacity = __capacity_for(__size + 1);
+		if(capacity <= __capacity)
+			capacity = (__size + 1) * 2 > __capacity * __desired_load_factor ? __capacity * 2 : __capacity;
+		__resize(capacity);
+	}
+
+	// build the key from key and the mapped value from args in slot p
+	template<class K, class... Args>
+	void __construct_slot(position p, K&& key, Args&&... args)
+	{
+		key_traits::construct(__key_alloc, __keys + p, ::forward<K>(key));
+		try
+		{
+			mapped_traits::construct(__mapped_alloc, __mapped + p, ::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			key_traits::destroy(__key_alloc, __keys + p);
+			throw;
+		}
+	}
+
+	template<class K, class... Args>
+	void __construct_at(position p, size_type hash, K&& key, Args&&... args)
+	{
+		__construct_slot(p, ::forward<K>(key), ::forward<Args>(args)...);
+		if(__ctrl[p] == CTRL_DELETED)
+			--__deleted;
+		__ctrl[p] = __h2(hash);
+		++__size;
+	}
+
+	// move a key and its mapped value into the raw slot p, ending the originals
+	void __relocate_slot(position p, key_type* key, mapped_type* mapped)
+	{
+		__relocate_n(__key_alloc, __keys + p, key, 1);
+		try
+		{
+			__relocate_n(__mapped_alloc, __mapped + p, mapped, 1);
+		}
+		catch(...)
+		{
+			__relocate_n(__key_alloc, key, __keys + p, 1);
+			throw;
+		}
+	}
+
+	void __destroy_slot(position p)
+	{
+		key_traits::destroy(__key_alloc, __keys + p);
+		mapped_traits::destroy(__mapped_alloc, __mapped + p);
+	}
+
+	void __allocate(size_type capacity)
+	{
+		if(capacity == 0)
+			return;
+		key_type* keys = key_traits::allocate(__key_alloc, capacity);
+		mapped_type* mapped = nullptr;
+		try
+		{
+			mapped = mapped_traits::allocate(__mapped_alloc, capacity);
+			__ctrl = ctrl_traits::allocate(__ctrl_alloc, capacity);
+		}
+		catch(...)
+		{
+			if(mapped)
+				mapped_traits::deallocate(__mapped_alloc, mapped, capacity);
+			key_traits::deallocate(__key_alloc, keys, capacity);
+			throw;
+		}
+		__keys = keys;
+		__mapped = mapped;
+		std::memset(__ctrl, CTRL_EMPTY, capacity);
+		__capacity = capacity;
+		__stats.array_allocated();
+	}
+
+	void __deallocate_arrays(key_type* keys, mapped_type* mapped, ctrl_t* ctrl, size_type capacity)
+	{
+		key_traits::deallocate(__key_alloc, keys, capacity);
+		mapped_traits::deallocate(__mapped_alloc, mapped, capacity);
+		ctrl_traits::deallocate(__ctrl_alloc, ctrl, capacity);
+	}
+
+	void __deallocate()
+	{
+		if(__keys)
+			__deallocate_arrays(__keys, __mapped, __ctrl, __capacity);
+		__keys = nullptr;
+		__mapped = nullptr;
+		__ctrl = nullptr;
+		__capacity = 0;
+	}
+
+	hasher __hash;
+	key_equal __equal;
+	key_allocator __key_alloc;
+	mapped_allocator __mapped_alloc;
+	ctrl_allocator __ctrl_alloc;
+	key_type* __keys;
+	mapped_type* __mapped;
+	ctrl_t* __ctrl;
+	size_type __capacity;
+	size_type __size;
+	size_type __deleted;
+	float __desired_load_factor;
+	__loadFloor __floor;			// minimum load factor
+	stats_type __stats;
+};
+
+#endif // __SOA_STORAGE_H__
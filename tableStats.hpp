@@ -0,0 +1,183 @@
+#ifndef __TABLE_STATS_H__
+#define __TABLE_STATS_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+// A point in time view of a table, returned by hashTable::stats().
+//
+// The shape of the table is measured when the snapshot is taken, so it is
+// always filled in. A chain is a bucket's list for chained storage and the
+// number of groups a lookup of an element probes for flat storage. The
+// counters are only kept when the policy sets STATS; otherwise they read
+// zero and cost nothing.
+struct hashTableStats
+{
+	// histograms count lengths 0 .. HISTOGRAM - 2 exactly and everything
+	// longer in the last entry
+	enum { HISTOGRAM = 16 };
+
+	hashTableStats()
+		: counting(false), size(0), bucket_count(0), load_factor(0), max_chain(0),
+		  lookups(0), max_probe(0), rehashes(0), rehash_ns(0), reseeds(0),
+		  node_allocations(0), node_deallocations(0), array_allocations(0)
+	{
+		for(std::size_t i = 0; i < HISTOGRAM; ++i)
+			chain_histogram[i] = probe_histogram[i] = 0;
+	}
+
+	static std::size_t bin(std::size_t length) { return length < HISTOGRAM - 1 ? length : HISTOGRAM - 1; }
+
+	bool counting;					// whether the counters below were kept
+
+	// shape
+	std::size_t size;
+	std::size_t bucket_count;
+	float load_factor;
+	std::size_t chain_histogram[HISTOGRAM];	// buckets (chained) or elements (flat) by chain length
+	std::size_t max_chain;
+
+	// counters
+	std::size_t lookups;
+	std::size_t probe_histogram[HISTOGRAM];	// lookups by nodes or groups inspected
+	std::size_t max_probe;
+	std::size_t rehashes;
+	double rehash_ns;						// total time spent rehashing
+	std::size_t reseeds;					// rehashes under a new seed after a long chain
+	std::size_t node_allocations;
+	std::size_t node_deallocations;
+	std::size_t array_allocations;			// bucket, slot and control arrays
+};
+
+// The heap memory a table holds, returned by hashTable::memory_usage().
+//
+// Arrays and slabs count at their allocated size, so empty slots, spare
+// pooled nodes and an old bucket array still being migrated are included.
+// Memory inside the table object itself, such as small storage's inline
+// array, is not. overhead estimates the allocator's own bookkeeping at
+// ALLOCATION_OVERHEAD bytes per block, about what glibc malloc keeps.
+struct hashTableMemory
+{
+	enum { ALLOCATION_OVERHEAD = 2 * sizeof(void*) };
+
+	hashTableMemory() : buckets(0), elements(0), overhead(0), blocks(0) {}
+
+	std::size_t total() const { return buckets + elements + overhead; }
+
+	// a storage adds each of its arrays or slabs, or blocks of them at once
+	void add_buckets(std::size_t bytes, std::size_t count = 1) { buckets += bytes; __add_blocks(bytes ? count : 0); }
+	void add_elements(std::size_t bytes, std::size_t count = 1) { elements += bytes; __add_blocks(bytes ? count : 0); }
+
+	std::size_t buckets;	// bucket heads, control bytes or index slots
+	std::size_t elements;	// nodes, slots or values
+	std::size_t overhead;
+	std::size_t blocks;		// allocations behind the bytes above
+
+private:
+	void __add_blocks(std::size_t count)
+	{
+		blocks += count;
+		overhead += count * ALLOCATION_OVERHEAD;
+	}
+};
+
+// Keeps the counters for a storage backend. The disabled recorder is empty
+// and every call on it compiles away.
+template<bool Enabled>
+struct statsRecorder
+{
+	typedef int time_point;
+
+	void probe(std::size_t) const {}
+	void chain(std::size_t, std::size_t) {}
+	time_point rehash_begin() const { return 0; }
+	void rehash_end(time_point) {}
+	void reseeded() {}
+	void node_allocated(std::size_t = 1) {}
+	void node_deallocated(std::size_t = 1) {}
+	void array_allocated() {}
+	void fill(hashTableStats&) const {}
+};
+
+template<>
+struct statsRecorder<true>
+{
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	statsRecorder()
+		: lookups(0), max_probe(0), rehashes(0), rehash_ns(0), reseeds(0),
+		  node_allocations(0), node_deallocations(0), array_allocations(0), warned(false)
+	{
+		for(std::size_t i = 0; i < hashTableStats::HISTOGRAM; ++i)
+			probes[i] = 0;
+	}
+
+	// lookups are const, so their counters are mutable; a table that keeps
+	// stats must not be read from several threads at once
+	void probe(std::size_t length) const
+	{
+		++lookups;
+		++probes[hashTableStats::bin(length)];
+		if(length > max_probe)
+			max_probe = length;
+	}
+
+	// an insert landed at the given chain length; past the threshold this
+	// is almost always a degenerate hash or hash flooding, so debug builds
+	// say so once
+	void chain(std::size_t length, std::size_t threshold)
+	{
+#ifndef NDEBUG
+		if(length > threshold && !warned)
+		{
+			warned = true;
+			std::fprintf(stderr, "hashTable: chain of length %zu exceeds %zu, check the hash function\n",
+				length, threshold);
+		}
+#else
+		(void)length;
+		(void)threshold;
+#endif
+	}
+
+	time_point rehash_begin() const { return std::chrono::steady_clock::now(); }
+	void rehash_end(time_point start)
+	{
+		++rehashes;
+		rehash_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void reseeded() { ++reseeds; }
+	void node_allocated(std::size_t count = 1) { node_allocations += count; }
+	void node_deallocated(std::size_t count = 1) { node_deallocations += count; }
+	void array_allocated() { ++array_allocations; }
+
+	void fill(hashTableStats& s) const
+	{
+		s.counting = true;
+		s.lookups = lookups;
+		for(std::size_t i = 0; i < hashTableStats::HISTOGRAM; ++i)
+			s.probe_histogram[i] = probes[i];
+		s.max_probe = max_probe;
+		s.rehashes = rehashes;
+		s.rehash_ns = rehash_ns;
+		s.reseeds = reseeds;
+		s.node_allocations = node_allocations;
+		s.node_deallocations = node_deallocations;
+		s.array_allocations = array_allocations;
+	}
+
+	mutable std::size_t lookups;
+	mutable std::size_t probes[hashTableStats::HISTOGRAM];
+	mutable std::size_t max_probe;
+	std::size_t rehashes;
+	double rehash_ns;
+	std::size_t reseeds;
+	std::size_t node_allocations;
+	std::size_t node_deallocations;
+	std::size_t array_allocations;
+	bool warned;
+};
+
+#endif // __TABLE_STATS_H__
@@ -0,0 +1,103 @@
+// concurrent_hashTable under threads that insert, erase and look up at
+// once while the stripes grow from a single bucket each, and then again
+// with clear() running alongside them.
+//
+// Every value is derived from its key, so a lookup that lands on the
+// wrong or a half built node shows up as a mismatch. Exits non-zero on
+// the first failure.
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../concurrentHashTable.hpp"
+
+typedef concurrent_hashTable<long, long> table_type;
+
+enum { THREADS = 8, KEYS_PER_THREAD = 20000 };
+
+static std::atomic<int> failures(0);
+
+static void check(bool ok, const char* what, long key)
+{
+	if(ok)
+		return;
+	if(failures.fetch_add(1) < 10)
+		std::printf("FAIL %s (key %ld)\n", what, key);
+}
+
+static long value_of(long key, long round) { return key * 4 + round; }
+
+// a lookup of key may miss, but what it finds must belong to key
+static void look_up(const table_type& table, long key)
+{
+	long out = -1;
+	if(table.find(key, out))
+		check(out / 4 == key, "find returns the key's own value", key);
+}
+
+// thread t owns the keys t, t + THREADS, ... and reads everyone's
+static void writer(table_type& table, int t, bool cleared)
+{
+	for(long i = 0; i < KEYS_PER_THREAD; ++i)
+	{
+		long key = i * THREADS + t;
+		bool inserted = table.try_emplace(key, value_of(key, 0));
+		check(inserted || cleared, "try_emplace inserts a new key", key);
+		look_up(table, key);
+		look_up(table, (i * THREADS + t + 1) % (KEYS_PER_THREAD * THREADS));
+		if(i % 3 == 0)
+			table.insert_or_assign(key, value_of(key, 1));
+		if(i % 5 == 0)
+			check(table.erase(key) == 1 || cleared, "erase removes a present key", key);
+	}
+}
+
+static void run(bool with_clear)
+{
+	table_type table(1);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < THREADS; ++t)
+		threads.emplace_back(writer, std::ref(table), t, with_clear);
+	std::thread clearer([&]
+	{
+		while(with_clear && !done.load())
+		{
+			table.clear();
+			std::this_thread::yield();
+		}
+	});
+	for(std::size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	done.store(true);
+	clearer.join();
+
+	// single threaded again: size() must agree with the keys present
+	std::size_t present = 0;
+	for(long key = 0; key < long(KEYS_PER_THREAD) * THREADS; ++key)
+	{
+		long out = -1;
+		bool found = table.find(key, out);
+		present += found;
+		if(!with_clear)
+		{
+			long i = key / THREADS;
+			check(found == (i % 5 != 0), "only erased keys are missing", key);
+			if(found)
+				check(out == value_of(key, i % 3 == 0 ? 1 : 0), "the last write wins", key);
+		}
+	}
+	check(present == table.size(), "size() counts the keys present", long(present));
+	check(table.load_factor() <= table.max_load_factor() * 2, "the stripes grew", long(table.bucket_count()));
+	table.clear();
+	check(table.size() == 0 && !table.contains(1), "clear() empties the table", 0);
+}
+
+int main()
+{
+	run(false);
+	run(true);
+
+	std::printf("%s\n", failures ? "concurrentTest: failed" : "concurrentTest: ok");
+	return failures ? 1 : 0;
+}
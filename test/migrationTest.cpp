@@ -0,0 +1,70 @@
+// The bucket interface of an incremental chained table in the middle of a
+// migration: every element must be in exactly one bucket, and bucket(key)
+// must be a bucket whose local iterators reach key, and stats() must count
+// the same buckets as bucket_count().
+//
+// Exits non-zero on the first failure.
+#include <cstdio>
+#include <vector>
+#include "../hashTable.hpp"
+
+typedef hashTable<int, int, std::hash<int>, std::equal_to<int>,
+	std::allocator<pair<const int, int> >, incremental_chained_policy> table_type;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, int key)
+{
+	if(ok)
+		return;
+	std::printf("FAIL %s (key %d)\n", what, key);
+	++failures;
+}
+
+// walk every bucket and check it against the table
+static void walk(const table_type& table, int keys)
+{
+	std::vector<int> seen(keys, 0);
+	std::size_t total = 0;
+	for(std::size_t n = 0; n < table.bucket_count(); ++n)
+	{
+		std::size_t length = 0;
+		for(table_type::const_local_iterator it = table.begin(n); it != table.end(n); ++it, ++length)
+		{
+			++seen[it->first];
+			check(table.bucket(it->first) == n, "bucket(key) names the bucket holding it", it->first);
+		}
+		check(length == table.bucket_size(n), "bucket_size matches the local iterators", int(n));
+		total += length;
+	}
+	check(total == table.size(), "buckets hold size() elements", keys);
+	hashTableStats s = table.stats();
+	check(s.bucket_count == table.bucket_count(), "stats() counts the buckets bucket_count() does", int(s.bucket_count));
+	check(s.load_factor == table.load_factor(), "stats() and load_factor() agree", keys);
+	for(int k = 0; k < keys; ++k)
+		check(seen[k] == (table.find(k) != table.end() ? 1 : 0), "each element is in one bucket", k);
+}
+
+int main()
+{
+	table_type table;
+	int keys = 0;
+	// grow past a rehash of thousands of buckets, which each insert then
+	// migrates REHASH_STEP at a time, and stop a few inserts into it
+	int stop = -1;
+	for(; keys != stop; ++keys)
+	{
+		std::size_t buckets = table.bucket_count();
+		table.try_emplace(keys, keys);
+		if(stop < 0 && keys >= 10000 && table.bucket_count() > buckets)
+			stop = keys + 10;
+	}
+	walk(table, keys);
+	// erases leave the migration where it is
+	for(int k = 0; k < keys; k += 3)
+		table.erase(k);
+	walk(table, keys);
+
+	std::printf("%s\n", failures ? "migrationTest: failed" : "migrationTest: ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+// snapshot_hashTable with a writer per table and readers on both tables.
+//
+// Each commit sets every key but one to the commit's generation, so a
+// snapshot must show one generation throughout, with that generation's
+// key missing. The tables' allocator flags any use of it from two threads
+// at once: versions replaced in one table are retired through the epoch
+// domain that the other table's writer also retires into, and must still
+// be freed by their own table's writer.
+//
+// Exits non-zero on the first failure.
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../snapshotHashTable.hpp"
+
+enum { KEYS = 200, COMMITS = 2000, READERS = 3 };
+
+static std::atomic<int> failures(0);
+
+static void check(bool ok, const char* what, long value)
+{
+	if(ok)
+		return;
+	if(failures.fetch_add(1) < 10)
+		std::printf("FAIL %s (%ld)\n", what, value);
+}
+
+// std::allocator behind a flag that is set while a call is in progress
+template<class T>
+struct exclusiveAllocator
+{
+	typedef T value_type;
+
+	explicit exclusiveAllocator(std::atomic<bool>* busy) : busy(busy) {}
+	template<class U>
+	exclusiveAllocator(const exclusiveAllocator<U>& other) : busy(other.busy) {}
+
+	T* allocate(std::size_t n)
+	{
+		enter();
+		T* p = std::allocator<T>().allocate(n);
+		busy->store(false);
+		return p;
+	}
+	void deallocate(T* p, std::size_t n)
+	{
+		enter();
+		std::allocator<T>().deallocate(p, n);
+		busy->store(false);
+	}
+	void enter() { check(!busy->exchange(true), "the allocator is used by one thread at a time", 0); }
+
+	std::atomic<bool>* busy;
+};
+template<class T, class U>
+bool operator==(const exclusiveAllocator<T>& lhs, const exclusiveAllocator<U>& rhs) { return lhs.busy == rhs.busy; }
+template<class T, class U>
+bool operator!=(const exclusiveAllocator<T>& lhs, const exclusiveAllocator<U>& rhs) { return lhs.busy != rhs.busy; }
+
+typedef snapshot_hashTable<long, long, std::hash<long>, std::equal_to<long>,
+	exclusiveAllocator<pair<const long, long> > > table_type;
+
+static void writer(table_type& table)
+{
+	for(long gen = 1; gen <= COMMITS; ++gen)
+	{
+		table_type::batch b = table.write();
+		for(long k = 0; k < KEYS; ++k)
+			b.insert_or_assign(k, gen);
+		b.erase(gen % KEYS);
+		// abandoned batches must leave no trace
+		if(gen % 97 == 0)
+			continue;
+		b.commit();
+	}
+}
+
+static void reader(const table_type& table, const std::atomic<bool>& done)
+{
+	while(!done.load())
+	{
+		table_type::snapshot s = table.read();
+		if(s.empty())
+			continue;
+		long gen = -1;
+		std::size_t seen = 0;
+		for(table_type::snapshot::const_iterator it = s.begin(); it != s.end(); ++it, ++seen)
+		{
+			if(gen < 0)
+				gen = it->second;
+			check(it->second == gen, "a snapshot shows one generation", it->second);
+		}
+		check(seen == s.size() && seen == KEYS - 1, "a snapshot holds all keys but one", long(seen));
+		check(!s.contains(gen % KEYS), "the generation's own key is missing", gen);
+		check(gen % 97 != 0, "abandoned batches are never seen", gen);
+	}
+}
+
+int main()
+{
+	std::atomic<bool> busy_a(false), busy_b(false);
+	{
+		table_type a(64, std::hash<long>(), std::equal_to<long>(), exclusiveAllocator<pair<const long, long> >(&busy_a));
+		table_type b(64, std::hash<long>(), std::equal_to<long>(), exclusiveAllocator<pair<const long, long> >(&busy_b));
+		std::atomic<bool> done(false);
+		std::vector<std::thread> readers;
+		for(int r = 0; r < READERS; ++r)
+			readers.emplace_back(reader, std::cref(r % 2 ? a : b), std::cref(done));
+		std::thread wa(writer, std::ref(a)), wb(writer, std::ref(b));
+		wa.join();
+		wb.join();
+		done.store(true);
+		for(std::size_t r = 0; r < readers.size(); ++r)
+			readers[r].join();
+		check(a.size() == KEYS - 1 && b.size() == KEYS - 1, "the last commit is current", long(a.size()));
+	}
+
+	std::printf("%s\n", failures ? "snapshotTest: failed" : "snapshotTest: ok");
+	return failures ? 1 : 0;
+}
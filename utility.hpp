@@ -2,7 +2,12 @@
 #define __UTILITY_H__
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 // FORWARD
 // forward an lvalue
@@ -19,6 +24,16 @@ constexpr T&& forward(typename std::remove_reference<T>::type&& t) noexcept
 	return static_cast<T&&>(t);
 }
 
+// TRAITS
+template<class T>
+struct __void { typedef void type; };
+
+// whether T declares is_transparent, as std::equal_to<> does
+template<class T, class = void>
+struct __is_transparent : std::false_type {};
+template<class T>
+struct __is_transparent<T, typename __void<typename T::is_transparent>::type> : std::true_type {};
+
 // start pair
 template<class T1, class T2>
 struct pair
@@ -33,7 +48,7 @@ struct pair
 	
 	template<class U1, class U2>
 	constexpr pair(U1&& x, U2&& y)
-		: first(forward<U1>(x)), second(forward<U2>(y)) {}
+		: first(::forward<U1>(x)), second(::forward<U2>(y)) {}
 	
 	template<class U1, class U2>
 	constexpr pair(const pair<U1, U2>& p)
@@ -41,21 +56,25 @@ struct pair
 	
 	template<class U1, class U2>
 	constexpr pair(pair<U1, U2>&& p)
-		: first(forward<U1>(p.first)), second(forward<U2>(p.second)) {}
+		: first(::forward<U1>(p.first)), second(::forward<U2>(p.second)) {}
+
+	// builds first and second in place from the arguments in x and y
+	template<class... Args1, class... Args2>
+	pair(std::piecewise_construct_t, std::tuple<Args1...> x, std::tuple<Args2...> y)
+		: pair(x, y, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
 
 	pair( const pair& p ) = default;
 	pair( pair&& p ) = default;
 	
-	pair& operator=(const pair& other)
-		{ first = other.first; second = other.second; return *this; }
+	// defaulted so that a pair of trivially copyable types is one too
+	pair& operator=(const pair& other) = default;
 	template<class U1, class U2>
 	pair& operator=(const pair<U1,U2>& other)
 		{ first = other.first; second = other.second; return *this; }
-	pair& operator=(pair&& other) noexcept((std::is_nothrow_move_assignable<T1>::value && std::is_nothrow_move_assignable<T2>::value))
-		{ first = forward<T1>(other.first); second = forward<T2>(other.second); return *this; }
+	pair& operator=(pair&& other) = default;
 	template<class U1, class U2>
 	pair& operator=(pair<U1,U2>&& other)
-		{ first = forward<U1>(other.first); second = forward<U2>(other.second); return *this; }
+		{ first = ::forward<U1>(other.first); second = ::forward<U2>(other.second); return *this; }
 
 	void swap(pair& other) noexcept(noexcept(swap(first, other.first)) && noexcept(swap(second, other.second)))
 	{
@@ -63,6 +82,11 @@ struct pair
 		swap(first, other.first);
 		swap(second, other.second);
 	}
+
+private:
+	template<class Tuple1, class Tuple2, std::size_t... I1, std::size_t... I2>
+	pair(Tuple1& x, Tuple2& y, std::index_sequence<I1...>, std::index_sequence<I2...>)
+		: first(std::get<I1>(std::move(x))...), second(std::get<I2>(std::move(y))...) {}
 }; // end class pair
 
 template< class T1, class T2 >
@@ -87,6 +111,99 @@ inline constexpr bool operator>=( const pair<T1,T2>& lhs, const pair<T1,T2>& rhs
 
 template<class T1, class T2>
 inline constexpr pair<T1, T2> make_pair(T1&& x, T2&& y)
-{ return pair<T1, T2>(forward<T1>(x), forward<T2>(y)); }
+{ return pair<T1, T2>(::forward<T1>(x), ::forward<T2>(y)); }
+
+// RELOCATION
+// Whether a T may be moved to new storage, ending the original, by copying
+// its bytes. Trivially copyable types may; specialise this for others that
+// may too, such as a type holding only a std::unique_ptr.
+template<class T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template<class T1, class T2>
+struct is_trivially_relocatable<pair<T1, T2> >
+	: std::integral_constant<bool, is_trivially_relocatable<typename std::remove_const<T1>::type>::value
+		&& is_trivially_relocatable<typename std::remove_const<T2>::type>::value> {};
+
+// relocation skips the allocator's construct and destroy, so it is only
+// done with std::allocator, whose construct and destroy do nothing else
+template<class Alloc, class T>
+struct __bitwise_relocatable
+	: std::integral_constant<bool, is_trivially_relocatable<T>::value
+		&& std::is_same<Alloc, std::allocator<T> >::value> {};
+
+template<class Alloc, class T>
+void __relocate_n(Alloc&, T* to, T* from, std::size_t n, std::true_type)
+{
+	if(n)
+		std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), n * sizeof(T));
+}
+
+template<class Alloc, class T>
+void __relocate_n(Alloc& alloc, T* to, T* from, std::size_t n, std::false_type)
+{
+	typedef std::allocator_traits<Alloc> traits;
+	std::size_t i = 0;
+	try
+	{
+		for(; i < n; ++i)
+			traits::construct(alloc, to + i, std::move_if_noexcept(from[i]));
+	}
+	catch(...)
+	{
+		while(i)
+			traits::destroy(alloc, to + --i);
+		throw;
+	}
+	for(i = 0; i < n; ++i)
+		traits::destroy(alloc, from + i);
+}
+
+// move n elements from into the raw storage to and end the originals; the
+// ranges must not overlap. Elements whose move may throw are copied, and
+// the originals are only ended once all are in place, so a throw leaves
+// from as it was and to empty.
+template<class Alloc, class T>
+void __relocate_n(Alloc& alloc, T* to, T* from, std::size_t n)
+{ __relocate_n(alloc, to, from, n, __bitwise_relocatable<Alloc, T>()); }
+
+// start pair_reference
+// Stands in for a pair<T1, T2>& whose halves are stored apart, as in a
+// structure of arrays table: first and second refer to the elements, and
+// the whole converts to a pair by value. An iterator handing these out
+// returns an arrow_proxy from operator->.
+template<class T1, class T2>
+struct pair_reference
+{
+	T1& first;
+	T2& second;
+
+	constexpr pair_reference(T1& x, T2& y)
+		: first(x), second(y) {}
+
+	// adds const, as from an iterator's reference to a const_iterator's
+	template<class U1, class U2>
+	constexpr pair_reference(const pair_reference<U1, U2>& p)
+		: first(p.first), second(p.second) {}
+
+	template<class U1, class U2>
+	constexpr operator pair<U1, U2>() const
+		{ return pair<U1, U2>(first, second); }
+}; // end class pair_reference
+
+template<class T1, class T2, class U1, class U2>
+inline constexpr bool operator==(const pair_reference<T1, T2>& lhs, const pair_reference<U1, U2>& rhs)
+	{ return (lhs.first == rhs.first) && (lhs.second == rhs.second); }
+template<class T1, class T2, class U1, class U2>
+inline constexpr bool operator!=(const pair_reference<T1, T2>& lhs, const pair_reference<U1, U2>& rhs)
+	{ return !(lhs == rhs); }
+
+// what operator-> returns for an iterator whose reference is a proxy
+template<class Reference>
+struct arrow_proxy
+{
+	const Reference* operator->() const { return &ref; }
+
+	Reference ref;
+};
 
 #endif // __UTILITY_H__
\ No newline at end of file